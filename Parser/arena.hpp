@@ -0,0 +1,167 @@
+/*******************************************************************************
+ * Allocates many small objects of the same type together.  Building a lexer or
+ * a parse table creates large numbers of finite states, outputs, nodes, parse
+ * states and rules, which are all kept until the program is done with them.
+ */
+#ifndef arena_hpp
+#define arena_hpp
+
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/*******************************************************************************
+ * Builds objects in blocks of memory that each hold several objects next to
+ * each other.  Making an object only moves an index within the current block,
+ * and every object is destroyed at once when the arena is destroyed.  Objects
+ * never move, so pointers to them stay valid for the life of the arena.  Each
+ * new block is twice the size of the last, up to a limit.
+ */
+template <typename T>
+class Arena
+{
+  public:
+    Arena();
+    Arena(Arena&& other);
+    Arena& operator=(Arena&& other);
+    ~Arena();
+
+    /** Builds a new object owned by the arena. */
+    template <typename... Args>
+    T* make(Args&&... args);
+
+    /** Takes ownership of every object in the other arena. */
+    void splice(Arena& other);
+
+    /** Calls the visitor with each object in the order they were made. */
+    template <typename Visit>
+    void each(Visit visit) const;
+
+    size_t size() const;
+
+  private:
+    typedef typename std::aligned_storage<sizeof(T), alignof(T)>::type Slot;
+    struct Block {
+        std::unique_ptr<Slot[]> slots;
+        size_t capacity;
+        size_t used;
+    };
+    std::vector<Block> blocks;
+    size_t count;
+
+    static const size_t first_block = 16;
+    static const size_t last_block = 4096;
+
+    void clear();
+};
+
+/******************************************************************************/
+template <typename T>
+Arena<T>::Arena():
+    count(0){}
+
+template <typename T>
+Arena<T>::Arena(Arena&& other):
+    blocks(std::move(other.blocks)),
+    count(other.count)
+{
+    other.blocks.clear();
+    other.count = 0;
+}
+
+template <typename T>
+Arena<T>&
+Arena<T>::operator=(Arena&& other)
+{
+    if (this != &other) {
+        clear();
+        blocks = std::move(other.blocks);
+        count = other.count;
+        other.blocks.clear();
+        other.count = 0;
+    }
+    return *this;
+}
+
+template <typename T>
+Arena<T>::~Arena() {
+    clear();
+}
+
+/**
+ * The block is only counted as used after the constructor returns, so an
+ * object that throws while being built is never destroyed.
+ */
+template <typename T>
+template <typename... Args>
+T*
+Arena<T>::make(Args&&... args)
+{
+    if (blocks.empty() || blocks.back().used == blocks.back().capacity) {
+        size_t capacity = first_block;
+        if (!blocks.empty()) {
+            capacity = blocks.back().capacity * 2;
+        }
+        if (capacity > last_block) {
+            capacity = last_block;
+        }
+        blocks.push_back({std::make_unique<Slot[]>(capacity), capacity, 0});
+    }
+
+    Block& block = blocks.back();
+    T* result = new (&block.slots[block.used]) T(std::forward<Args>(args)...);
+    block.used++;
+    count++;
+    return result;
+}
+
+/**
+ * The blocks of the other arena are moved after the blocks of this arena.  A
+ * partly used block of this arena is left partly used.
+ */
+template <typename T>
+void
+Arena<T>::splice(Arena& other)
+{
+    for (auto& block : other.blocks) {
+        blocks.push_back(std::move(block));
+    }
+    count += other.count;
+    other.blocks.clear();
+    other.count = 0;
+}
+
+template <typename T>
+template <typename Visit>
+void
+Arena<T>::each(Visit visit) const
+{
+    for (auto& block : blocks) {
+        for (size_t i = 0; i < block.used; i++) {
+            visit(*reinterpret_cast<const T*>(&block.slots[i]));
+        }
+    }
+}
+
+template <typename T>
+size_t
+Arena<T>::size() const {
+    return count;
+}
+
+template <typename T>
+void
+Arena<T>::clear()
+{
+    for (auto& block : blocks) {
+        for (size_t i = 0; i < block.used; i++) {
+            reinterpret_cast<T*>(&block.slots[i])->~T();
+        }
+    }
+    blocks.clear();
+    count = 0;
+}
+
+#endif
@@ -0,0 +1,142 @@
+#include "bitset.hpp"
+
+/******************************************************************************/
+Bitset::Bitset(){}
+
+bool
+Bitset::insert(size_t value)
+{
+    size_t index = value / bits;
+    uint64_t mask = (uint64_t)1 << (value % bits);
+
+    if (index >= words.size()) {
+        words.resize(index + 1, 0);
+    }
+    if (words[index] & mask) {
+        return false;
+    }
+    words[index] |= mask;
+    return true;
+}
+
+/**
+ * Unions the other set into this set one word at a time.  Since the last word
+ * of the other set is not zero, the last word of the result is also not zero.
+ */
+bool
+Bitset::insert(const Bitset& other)
+{
+    if (other.words.size() > words.size()) {
+        words.resize(other.words.size(), 0);
+    }
+
+    bool found = false;
+    for (size_t i = 0; i < other.words.size(); i++) {
+        uint64_t word = words[i] | other.words[i];
+        if (word != words[i]) {
+            words[i] = word;
+            found = true;
+        }
+    }
+    return found;
+}
+
+bool
+Bitset::contains(size_t value) const
+{
+    size_t index = value / bits;
+    if (index >= words.size()) {
+        return false;
+    }
+    return (words[index] >> (value % bits)) & 1;
+}
+
+bool
+Bitset::empty() const {
+    return words.empty();
+}
+
+size_t
+Bitset::size() const
+{
+    size_t result = 0;
+    for (uint64_t word : words) {
+        result += __builtin_popcountll(word);
+    }
+    return result;
+}
+
+size_t
+Bitset::hash() const
+{
+    size_t result = words.size();
+    for (uint64_t word : words) {
+        result ^= word + 0x9e3779b97f4a7c15 + (result << 6) + (result >> 2);
+    }
+    return result;
+}
+
+Bitset::iterator
+Bitset::begin() const {
+    return iterator(&words, 0);
+}
+
+Bitset::iterator
+Bitset::end() const {
+    return iterator(&words, words.size() * bits);
+}
+
+bool
+Bitset::operator==(const Bitset& other) const {
+    return words == other.words;
+}
+
+bool
+Bitset::operator!=(const Bitset& other) const {
+    return words != other.words;
+}
+
+bool
+Bitset::operator<(const Bitset& other) const {
+    return words < other.words;
+}
+
+/******************************************************************************/
+Bitset::iterator::iterator(const std::vector<uint64_t>* words, size_t value):
+    words   (words),
+    value   (value) {
+    skip();
+}
+
+size_t
+Bitset::iterator::operator*() const {
+    return value;
+}
+
+Bitset::iterator&
+Bitset::iterator::operator++() {
+    value++;
+    skip();
+    return *this;
+}
+
+bool
+Bitset::iterator::operator!=(const iterator& other) const {
+    return value != other.value;
+}
+
+/** Moves to the next set bit, or to the end if there are no more values. */
+void
+Bitset::iterator::skip()
+{
+    size_t end = words->size() * bits;
+    while (value < end) {
+        uint64_t word = (*words)[value / bits] >> (value % bits);
+        if (word) {
+            value += __builtin_ctzll(word);
+            return;
+        }
+        value = (value / bits + 1) * bits;
+    }
+    value = end;
+}
@@ -0,0 +1,59 @@
+/*******************************************************************************
+ * Compact set of small integers.  The terminals of a grammar are numbered
+ * densely as they are read, so sets of terminals such as the firsts and follows
+ * of a nonterminal or the lookaheads of an item are stored as bits in an array
+ * of words.
+ */
+#ifndef bitset_hpp
+#define bitset_hpp
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+/*******************************************************************************
+ * Set of integers stored as bits.  The union of two sets is a bitwise or of
+ * their words instead of inserting each value into a tree.  The last word is
+ * never zero, so two equal sets always have the same words.
+ */
+class Bitset
+{
+  public:
+    Bitset();
+
+    /** Returns true if the value or any of the values are new to the set. */
+    bool insert(size_t value);
+    bool insert(const Bitset& other);
+
+    bool contains(size_t value) const;
+    bool empty() const;
+    size_t size() const;
+    size_t hash() const;
+
+    /** Visits the values of the set in increasing order. */
+    class iterator {
+      public:
+        iterator(const std::vector<uint64_t>* words, size_t value);
+        size_t operator*() const;
+        iterator& operator++();
+        bool operator!=(const iterator& other) const;
+
+      private:
+        const std::vector<uint64_t>* words;
+        size_t value;
+        void skip();
+    };
+
+    iterator begin() const;
+    iterator end() const;
+
+    bool operator==(const Bitset& other) const;
+    bool operator!=(const Bitset& other) const;
+    bool operator<(const Bitset& other) const;
+
+  private:
+    std::vector<uint64_t> words;
+    static const size_t bits = 64;
+};
+
+#endif
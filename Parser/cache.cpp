@@ -0,0 +1,475 @@
+#include "cache.hpp"
+
+#include <algorithm>
+#include <sstream>
+
+/** Identifies the file and the version of its layout. */
+static const uint64_t magic = 0x6c72636163686537;
+
+/******************************************************************************/
+uint64_t
+Cache::lexer_fingerprint(const Grammar& grammar)
+{
+    uint64_t result = 0xcbf29ce484222325;
+    hash(grammar.all_terms.size(), &result);
+    for (Symbol* symbol : grammar.all_terms) {
+        if (Term* term = Term::cast(symbol)) {
+            hash(term->name, &result);
+            hash(term->rank, &result);
+        }
+    }
+
+    hash(grammar.lexer.patterns.size(), &result);
+    for (auto& pattern : grammar.lexer.patterns) {
+        hash(pattern.accept->id, &result);
+        hash(pattern.text, &result);
+        hash(pattern.regex, &result);
+    }
+    return result;
+}
+
+/**
+ * The parse states only refer to symbols and rules by their ids, so renaming a
+ * symbol or changing the pattern of a terminal does not change the states.  The
+ * precedence of the terminals and rules changes the resolved actions, and the
+ * unit rules that are skipped depend on the types and actions of the rules.
+ */
+uint64_t
+Cache::states_fingerprint(const Grammar& grammar)
+{
+    uint64_t result = 0xcbf29ce484222325;
+    hash(grammar.method, &result);
+    hash(grammar.skip_units, &result);
+    hash(grammar.all_terms.size(), &result);
+    for (Symbol* symbol : grammar.all_terms) {
+        if (Term* term = Term::cast(symbol)) {
+            hash(term->precedence, &result);
+            hash(term->assoc, &result);
+        }
+    }
+    hash(grammar.nonterms.size(), &result);
+    if (grammar.all.size() > 0) {
+        hash(grammar.all.front()->id, &result);
+    }
+
+    hash(grammar.all_rules.size(), &result);
+    for (Nonterm::Rule* rule : grammar.all_rules) {
+        hash(rule->nonterm->id, &result);
+        hash(rule->prec ? rule->prec->id : 0, &result);
+        hash(grammar.skip_units && Grammar::is_unit(rule), &result);
+        hash(rule->product.size(), &result);
+        for (Symbol* symbol : rule->product) {
+            hash(symbol->kind, &result);
+            hash(symbol->id, &result);
+        }
+    }
+    return result;
+}
+
+/**
+ * The conflict report names the symbols of the rules, so a report is only
+ * reused while the names of the symbols are the same.
+ */
+uint64_t
+Cache::names_fingerprint(const Grammar& grammar)
+{
+    uint64_t result = 0xcbf29ce484222325;
+    for (Symbol* symbol : grammar.all_terms) {
+        if (Term* term = Term::cast(symbol)) {
+            hash(term->name, &result);
+        }
+    }
+    for (auto& nonterm : grammar.nonterms) {
+        hash(nonterm.second->id, &result);
+        hash(nonterm.first, &result);
+    }
+    return result;
+}
+
+/**
+ * Hashes with FNV-1a, one byte at a time, so the fingerprint is the same on
+ * every platform.
+ */
+void
+Cache::hash(uint64_t value, uint64_t* result)
+{
+    for (int i = 0; i < 8; i++) {
+        *result ^= (value >> (i * 8)) & 0xff;
+        *result *= 0x100000001b3;
+    }
+}
+
+void
+Cache::hash(const std::string& text, uint64_t* result)
+{
+    hash(text.size(), result);
+    for (unsigned char c : text) {
+        *result ^= c;
+        *result *= 0x100000001b3;
+    }
+}
+
+/******************************************************************************/
+void
+Cache::save(const Grammar& grammar, std::ostream& out)
+{
+    write_number(magic, out);
+
+    std::ostringstream nodes;
+    save_nodes(grammar, nodes);
+    write_section(lexer_fingerprint(grammar), nodes.str(), out);
+
+    std::ostringstream states;
+    save_states(grammar, states);
+    write_section(states_fingerprint(grammar), states.str(), out);
+}
+
+void
+Cache::save_nodes(const Grammar& grammar, std::ostream& out)
+{
+    const Lexer& lexer = grammar.lexer;
+    write_number(lexer.nodes.size(), out);
+    write_number(lexer.initial ? lexer.initial->id : 0, out);
+    for (Node* node : lexer.nodes) {
+        write_number(node->accept ? node->accept->id : 0, out);
+        write_number(node->nexts.size(), out);
+        for (auto& next : node->nexts) {
+            write_number(next.first.first, out);
+            write_number(next.first.last, out);
+            write_number(next.second->id, out);
+        }
+    }
+}
+
+void
+Cache::save_states(const Grammar& grammar, std::ostream& out)
+{
+    write_number(grammar.states.size(), out);
+    write_number(grammar.start ? grammar.start->id : 0, out);
+    for (State* state : grammar.states) {
+        write_number(state->actions->shift.size(), out);
+        for (auto& shift : state->actions->shift) {
+            write_number(shift.first->id, out);
+            write_number(shift.second->id, out);
+        }
+        write_number(state->actions->reduce.size(), out);
+        for (auto& reduce : state->actions->reduce) {
+            write_number(reduce.first->id, out);
+            write_number(reduce.second->id, out);
+        }
+        write_number(state->actions->accept.size(), out);
+        for (auto& accept : state->actions->accept) {
+            write_number(accept.first->id, out);
+            write_number(accept.second->id, out);
+        }
+        Nonterm::Rule* rule = state->actions->reduce_default;
+        write_number(rule ? rule->id + 1 : 0, out);
+        write_number(state->gotos.size(), out);
+        for (auto& go : state->gotos) {
+            write_number(go.first->id, out);
+            write_number(go.second->id, out);
+        }
+    }
+    write_number(grammar.conflicts, out);
+    write_number(names_fingerprint(grammar), out);
+    write_text(grammar.conflict_report, out);
+}
+
+/**
+ * Each section is read completely into separate lists and only moved into the
+ * grammar if the whole section is valid, so a truncated or damaged file leaves
+ * that part of the grammar unsolved.
+ */
+void
+Cache::load(Grammar* grammar, std::istream& in, bool* lexer, bool* states)
+{
+    *lexer = false;
+    *states = false;
+
+    uint64_t value = 0;
+    if (!read_number(in, &value) || value != magic) {
+        return;
+    }
+
+    uint64_t fingerprint = 0;
+    std::string data;
+    if (!read_section(in, &fingerprint, &data)) {
+        return;
+    }
+    if (fingerprint == lexer_fingerprint(*grammar)) {
+        std::istringstream section(data);
+        size_t initial = 0;
+        Arena<Node> arena;
+        std::vector<Node*> nodes;
+        if (load_nodes(*grammar, section, &arena, &nodes, &initial)) {
+            grammar->lexer.initial = nodes[initial];
+            grammar->lexer.node_arena = std::move(arena);
+            grammar->lexer.nodes = nodes;
+            grammar->lexer.solve_moves();
+            *lexer = true;
+        }
+    }
+
+    if (!read_section(in, &fingerprint, &data)) {
+        return;
+    }
+    if (fingerprint == states_fingerprint(*grammar)) {
+        std::istringstream section(data);
+        size_t start = 0;
+        Arena<State> arena;
+        std::vector<State*> found;
+        uint64_t conflicts = 0;
+        uint64_t names = 0;
+        std::string report;
+        if (load_states(*grammar, section, &arena, &found, &start) &&
+                read_number(section, &conflicts) &&
+                read_number(section, &names) &&
+                read_text(section, &report) &&
+                (report.empty() || names == names_fingerprint(*grammar))) {
+            grammar->start = found[start];
+            grammar->state_arena = std::move(arena);
+            grammar->states = found;
+            grammar->conflicts = (size_t)conflicts;
+            grammar->conflict_report = report;
+            *states = true;
+        }
+    }
+}
+
+/**
+ * Reads the number of nodes and the initial node, and then the accepted
+ * terminal and the ranges to the next nodes for each node.
+ */
+bool
+Cache::load_nodes(const Grammar& grammar, std::istream& in, Arena<Node>* arena,
+                  std::vector<Node*>* nodes, size_t* initial)
+{
+    uint64_t count = 0;
+    if (!read_count(in, &count) || count == 0) {
+        return false;
+    }
+    for (size_t i = 0; i < count; i++) {
+        nodes->push_back(arena->make(i));
+    }
+    if (!read_index(in, nodes->size(), initial)) {
+        return false;
+    }
+
+    for (Node* node : *nodes) {
+        size_t accept = 0;
+        if (!read_index(in, grammar.all_terms.size(), &accept)) {
+            return false;
+        }
+        node->accept = Term::cast(grammar.all_terms[accept]);
+
+        uint64_t ranges = 0;
+        if (!read_number(in, &ranges)) {
+            return false;
+        }
+        for (size_t i = 0; i < ranges; i++) {
+            uint64_t first = 0;
+            uint64_t last = 0;
+            size_t next = 0;
+            if (!read_number(in, &first) || !read_number(in, &last)) {
+                return false;
+            }
+            if (!read_index(in, nodes->size(), &next)) {
+                return false;
+            }
+            node->add_next((int)first, (int)last, (*nodes)[next]);
+        }
+    }
+    return true;
+}
+
+/**
+ * Reads the number of states and the start state, and then the shifts,
+ * reduces, accepts, default reduction and gotos of each state.  The default is
+ * stored as one more than the id of its rule, or zero if the state has none.
+ */
+bool
+Cache::load_states(const Grammar& grammar, std::istream& in,
+                   Arena<State>* arena, std::vector<State*>* states,
+                   size_t* start)
+{
+    std::vector<Nonterm*> nonterms(grammar.nonterms.size());
+    for (auto& nonterm : grammar.nonterms) {
+        nonterms[nonterm.second->id] = nonterm.second.get();
+    }
+    const std::vector<Symbol*>& terms = grammar.all_terms;
+    const std::vector<Nonterm::Rule*>& rules = grammar.all_rules;
+
+    uint64_t count = 0;
+    if (!read_count(in, &count) || count == 0) {
+        return false;
+    }
+    for (size_t i = 0; i < count; i++) {
+        states->push_back(arena->make(i));
+    }
+    if (!read_index(in, states->size(), start)) {
+        return false;
+    }
+
+    for (State* state : *states) {
+        state->actions = std::make_unique<State::Actions>();
+        size_t symbol = 0;
+        size_t target = 0;
+        uint64_t size = 0;
+
+        if (!read_number(in, &size)) {
+            return false;
+        }
+        for (size_t i = 0; i < size; i++) {
+            if (!read_index(in, terms.size(), &symbol) ||
+                    !read_index(in, states->size(), &target)) {
+                return false;
+            }
+            state->actions->shift[terms[symbol]] = (*states)[target];
+        }
+
+        if (!read_number(in, &size)) {
+            return false;
+        }
+        for (size_t i = 0; i < size; i++) {
+            if (!read_index(in, terms.size(), &symbol) ||
+                    !read_index(in, rules.size(), &target)) {
+                return false;
+            }
+            state->actions->reduce[terms[symbol]] = rules[target];
+        }
+
+        if (!read_number(in, &size)) {
+            return false;
+        }
+        for (size_t i = 0; i < size; i++) {
+            if (!read_index(in, terms.size(), &symbol) ||
+                    !read_index(in, rules.size(), &target)) {
+                return false;
+            }
+            state->actions->accept[terms[symbol]] = rules[target];
+        }
+
+        if (!read_index(in, rules.size() + 1, &target)) {
+            return false;
+        }
+        if (target > 0) {
+            state->actions->reduce_default = rules[target - 1];
+        }
+
+        if (!read_number(in, &size)) {
+            return false;
+        }
+        for (size_t i = 0; i < size; i++) {
+            if (!read_index(in, nonterms.size(), &symbol) ||
+                    !read_index(in, states->size(), &target)) {
+                return false;
+            }
+            state->gotos[nonterms[symbol]] = (*states)[target];
+        }
+    }
+    return true;
+}
+
+/******************************************************************************/
+void
+Cache::write_section(uint64_t fingerprint, const std::string& data,
+                     std::ostream& out)
+{
+    write_number(fingerprint, out);
+    write_number(data.size(), out);
+    out.write(data.data(), data.size());
+}
+
+bool
+Cache::read_section(std::istream& in, uint64_t* fingerprint, std::string* data)
+{
+    uint64_t size = 0;
+    if (!read_number(in, fingerprint) || !read_number(in, &size)) {
+        return false;
+    }
+    
+    /** Reads in parts so a damaged length cannot allocate past the file. */
+    data->clear();
+    char buffer[4096];
+    while (data->size() < size) {
+        uint64_t part = std::min<uint64_t>(sizeof(buffer), size - data->size());
+        in.read(buffer, part);
+        if ((uint64_t)in.gcount() != part) {
+            return false;
+        }
+        data->append(buffer, part);
+    }
+    return true;
+}
+
+void
+Cache::write_text(const std::string& text, std::ostream& out)
+{
+    write_number(text.size(), out);
+    out.write(text.data(), text.size());
+}
+
+bool
+Cache::read_text(std::istream& in, std::string* text)
+{
+    uint64_t size = 0;
+    if (!read_count(in, &size)) {
+        return false;
+    }
+    text->resize(size);
+    in.read(&(*text)[0], size);
+    return (uint64_t)in.gcount() == size;
+}
+
+void
+Cache::write_number(uint64_t value, std::ostream& out)
+{
+    while (value >= 0x80) {
+        out.put((char)(0x80 | (value & 0x7f)));
+        value >>= 7;
+    }
+    out.put((char)value);
+}
+
+bool
+Cache::read_number(std::istream& in, uint64_t* value)
+{
+    *value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        int c = in.get();
+        if (c == EOF) {
+            return false;
+        }
+        *value |= (uint64_t)(c & 0x7f) << shift;
+        if ((c & 0x80) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Every item of a list takes at least one byte, so a count larger than the
+ * rest of the section is damaged and is rejected before making the items.
+ */
+bool
+Cache::read_count(std::istream& in, uint64_t* count)
+{
+    if (!read_number(in, count)) {
+        return false;
+    }
+    std::streamsize left = in.rdbuf()->in_avail();
+    return left >= 0 && *count <= (uint64_t)left;
+}
+
+/** Reads a number and checks that it is a valid index for a list. */
+bool
+Cache::read_index(std::istream& in, size_t size, size_t* index)
+{
+    uint64_t value = 0;
+    if (!read_number(in, &value) || value >= size) {
+        return false;
+    }
+    *index = (size_t)value;
+    return true;
+}
@@ -0,0 +1,71 @@
+/*******************************************************************************
+ * Stores the solved lexer and parse table of a grammar in a binary file.  Each
+ * part of the file is tagged with a fingerprint of the parts of the grammar it
+ * was solved from, so that a later run only solves again the parts of the
+ * grammar that changed.
+ */
+#ifndef cache_hpp
+#define cache_hpp
+
+#include "grammar.hpp"
+
+#include <cstdint>
+#include <iostream>
+
+/*******************************************************************************
+ * Saves and loads the nodes of the lexer and the actions and gotos of the parse
+ * states as two separate sections.  Changing only the pattern of a terminal
+ * invalidates just the lexer, and changing only the rules or the table method
+ * invalidates just the parse states.  The states are saved with the conflicts
+ * reported while solving them, which are reported again when loaded.  Symbols,
+ * rules, nodes and states are all stored by their ids, so the grammar must be
+ * read before loading to provide the symbols and rules.  Types, action names
+ * and includes are not part of the solved tables and are always written from
+ * the grammar as read.
+ */
+class Cache
+{
+  public:
+    /** Hashes the parts of the grammar that each section depends on. */
+    static uint64_t lexer_fingerprint(const Grammar& grammar);
+    static uint64_t states_fingerprint(const Grammar& grammar);
+    static uint64_t names_fingerprint(const Grammar& grammar);
+
+    /**
+     * Loads each section of the file that was saved for a grammar with the
+     * same fingerprint.  Sets lexer and states if the nodes of the lexer or
+     * the parse states were loaded.  Sections not loaded are left unsolved.
+     */
+    static void load(Grammar* grammar, std::istream& in,
+                     bool* lexer, bool* states);
+    static void save(const Grammar& grammar, std::ostream& out);
+
+  private:
+    /** Numbers are stored seven bits per byte, so small ids take one byte. */
+    static void write_number(uint64_t value, std::ostream& out);
+    static bool read_number(std::istream& in, uint64_t* value);
+    static bool read_count(std::istream& in, uint64_t* count);
+    static bool read_index(std::istream& in, size_t size, size_t* index);
+    static void write_text(const std::string& text, std::ostream& out);
+    static bool read_text(std::istream& in, std::string* text);
+
+    static void hash(uint64_t value, uint64_t* result);
+    static void hash(const std::string& text, uint64_t* result);
+
+    /** Each section is its fingerprint, its length in bytes, and its data. */
+    static void write_section(uint64_t fingerprint, const std::string& data,
+                              std::ostream& out);
+    static bool read_section(std::istream& in, uint64_t* fingerprint,
+                             std::string* data);
+
+    static void save_nodes(const Grammar& grammar, std::ostream& out);
+    static void save_states(const Grammar& grammar, std::ostream& out);
+    static bool load_nodes(const Grammar& grammar, std::istream& in,
+                           Arena<Node>* arena, std::vector<Node*>* nodes,
+                           size_t* initial);
+    static bool load_states(const Grammar& grammar, std::istream& in,
+                            Arena<State>* arena, std::vector<State*>* states,
+                            size_t* start);
+};
+
+#endif
@@ -2,7 +2,8 @@
 
 /******************************************************************************/
 void
-Code::write(const Grammar& grammar, std::ostream& out)
+Code::write(const Grammar& grammar, std::ostream& out, std::ostream* summary,
+            Stats* stats)
 {
     for (auto include : grammar.includes) {
         out << include << std::endl;
@@ -27,7 +28,7 @@ Code::write(const Grammar& grammar, std::ostream& out)
 
     write(grammar.lexer, out);
     
-    out << "Symbol endmark;\n";
+    out << "Symbol endmark = {\"$\", " << grammar.endmark.id << "};\n";
     out << "Symbol* Endmark = &endmark;\n\n";
     
     for (auto& nonterm : grammar.nonterms) {
@@ -38,8 +39,8 @@ Code::write(const Grammar& grammar, std::ostream& out)
     
     /** Sort the states so the data can be access by an array index. */
     std::vector<State*> states;
-    for (auto& state : grammar.states) {
-        states.push_back(state.get());
+    for (State* state : grammar.states) {
+        states.push_back(state);
     }
     
     struct {
@@ -52,15 +53,36 @@ Code::write(const Grammar& grammar, std::ostream& out)
     
     /** Methods that cast value pointers to user define types. */
     for (auto rule : grammar.all_rules) {
+        if (rule->action.empty()) {
+            continue;
+        }
         write_rule_action(rule, out);
         write_call_action(rule, out);
     }
     
     write_rules(grammar, out);
+    
+    Comb<Action> actions(grammar.all_terms.size());
+    solve_actions(states, &actions);
+    Comb<size_t> gotos(grammar.nonterms.size());
+    std::vector<int> defaults(grammar.nonterms.size(), -1);
+    solve_gotos(states, &gotos, &defaults);
         
-    write_actions(states, out);
-    write_gotos(states, out);
-    write_states(states, out);
+    write_actions(actions, out);
+    write_gotos(gotos, defaults, out);
+    write_states(states, actions, gotos, out);
+    
+    if (summary) {
+        actions.print("Actions", *summary);
+        gotos.print("Gotos", *summary);
+    }
+    if (stats) {
+        stats->count("table_states", states.size());
+        stats->count("action_entries", actions.count_entries());
+        stats->count("action_slots", actions.check.size());
+        stats->count("goto_entries", gotos.count_entries());
+        stats->count("goto_slots", gotos.check.size());
+    }
 }
 
 /*******************************************************************************
@@ -74,8 +96,8 @@ void
 Code::write(const Lexer& lexer, std::ostream& out)
 {
     std::vector<Node*> sorted;
-    for (auto& state : lexer.nodes) {
-        sorted.push_back(state.get());
+    for (Node* state : lexer.nodes) {
+        sorted.push_back(state);
     }
     struct {
         bool operator()(Node* a, Node* b) const {
@@ -102,7 +124,7 @@ void
 Code::write_terms(Term* term, std::ostream& out)
 {
     out << "Symbol term" << term->rank;
-    out << " = {\"" << term->name << "\"};\n";
+    out << " = {\"" << term->name << "\", " << term->id << "};\n";
 }
 
 void
@@ -174,7 +196,7 @@ void
 Code::write_nonterm(Nonterm* nonterm, std::ostream& out)
 {
     out << "Symbol nonterm" << nonterm->rank;
-    out << " = {\"" << nonterm->name << "\"};";
+    out << " = {\"" << nonterm->name << "\", " << nonterm->id << "};";
 }
 
 void
@@ -262,60 +284,136 @@ Code::write_rules(const Grammar& grammar, std::ostream& out)
 
 /******************************************************************************/
 void
-Code::write_actions(std::vector<State*> states, std::ostream& out)
+Code::solve_actions(const std::vector<State*>& states, Comb<Action>* actions)
 {
     for (auto s : states) {
-        out << "struct Act act" << s->id << "[] = {";
+        Comb<Action>::Row row;
         for (auto& act : s->actions->shift) {
-            out << "{&"; act.first->write(out);
-            out << ", 'S', " << act.second->id; out << "}, ";
+            row.push_back({act.first->id, {'S', act.second->id}});
         }
         for (auto& act : s->actions->reduce) {
-            out << "{&"; act.first->write(out);
-            out << ", 'R', " << act.second->id << "}, ";
+            row.push_back({act.first->id, {'R', act.second->id}});
         }
         for (auto& act : s->actions->accept) {
-            out << "{&"; act.first->write(out);
-            out << ", 'A', " << act.second->id << "}, ";
+            row.push_back({act.first->id, {'A', act.second->id}});
         }
-        out << "{nullptr, 0, 0}";
-        out << "};\n";
+        actions->add(row);
     }
-    out << "\n";
+    actions->solve();
 }
 
+/**
+ * The default of each nonterminal is the next state it goes to from the most
+ * states, choosing the lowest id if several are equally common.  Gotos to the
+ * default are left out of the rows of the states.
+ */
 void
-Code::write_gotos(std::vector<State*> states, std::ostream& out)
+Code::solve_gotos(const std::vector<State*>& states, Comb<size_t>* gotos,
+                  std::vector<int>* defaults)
 {
+    std::vector<std::map<size_t, size_t>> counts(defaults->size());
     for (auto s : states) {
-        if (!s->gotos.size()) {
-            continue;
+        for (auto& g : s->gotos) {
+            counts[g.first->id][g.second->id]++;
         }
-        out << "struct Go go" << s->id << "[] = {";
+    }
+    for (size_t id = 0; id < counts.size(); id++) {
+        size_t most = 0;
+        for (auto& count : counts[id]) {
+            if (count.second > most) {
+                most = count.second;
+                (*defaults)[id] = (int)count.first;
+            }
+        }
+    }
+    
+    for (auto s : states) {
+        Comb<size_t>::Row row;
         for (auto& g : s->gotos) {
-            out << "{&";
-            g.first->write(out);
-            out << ", " << g.second->id << "}, ";
+            if ((int)g.second->id != (*defaults)[g.first->id]) {
+                row.push_back({g.first->id, g.second->id});
+            }
         }
-        out << "{nullptr, 0}";
-        out << "};\n";
+        gotos->add(row);
     }
-    out << "\n";
+    gotos->solve();
+}
+
+void
+Code::write_actions(const Comb<Action>& actions, std::ostream& out)
+{
+    out << "int act_check[] = {\n";
+    write_numbers(actions.check, out);
+    out << "};\n\n";
+    
+    out << "struct Act act_next[] = {\n";
+    std::string line = "   ";
+    for (auto& next : actions.next) {
+        std::string entry = " {";
+        if (next.first) {
+            entry += "'" + std::string(1, next.first) + "'";
+        } else {
+            entry += "0";
+        }
+        entry += ", " + std::to_string(next.second) + "},";
+        if (line.size() + entry.size() > 80) {
+            out << line << "\n";
+            line = "   ";
+        }
+        line += entry;
+    }
+    out << line << "\n";
+    out << "};\n\n";
+}
+
+void
+Code::write_gotos(const Comb<size_t>& gotos, const std::vector<int>& defaults,
+                  std::ostream& out)
+{
+    out << "int go_check[] = {\n";
+    write_numbers(gotos.check, out);
+    out << "};\n\n";
+    
+    std::vector<int> next(gotos.next.begin(), gotos.next.end());
+    out << "int go_next[] = {\n";
+    write_numbers(next, out);
+    out << "};\n\n";
+    
+    out << "int go_default[] = {\n";
+    write_numbers(defaults, out);
+    out << "};\n\n";
 }
 
 void
-Code::write_states(std::vector<State*> states, std::ostream& out)
+Code::write_states(std::vector<State*> states, const Comb<Action>& actions,
+                   const Comb<size_t>& gotos, std::ostream& out)
 {
     out << "State states[] = {\n";
-    for (auto& s : states) {
-        out << "    {act" << s->id << ", ";
-        if (s->gotos.size() > 0) {
-            out << "go" << s->id;
+    for (size_t i = 0; i < states.size(); i++) {
+        State* s = states[i];
+        out << "    {" << actions.base(i) << ", " << gotos.base(i);
+        if (s->actions->reduce_default) {
+            out << ", " << s->actions->reduce_default->id;
         } else {
-            out << "nullptr";
+            out << ", -1";
         }
         out << "},\n";
     }
     out << "};\n\n";
 }
 
+/** Writes the numbers of an array, as many on each line as fit. */
+void
+Code::write_numbers(const std::vector<int>& numbers, std::ostream& out)
+{
+    std::string line = "   ";
+    for (int number : numbers) {
+        std::string entry = " " + std::to_string(number) + ",";
+        if (line.size() + entry.size() > 80) {
+            out << line << "\n";
+            line = "   ";
+        }
+        line += entry;
+    }
+    out << line << "\n";
+}
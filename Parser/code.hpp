@@ -7,6 +7,7 @@
 #define code_hpp
 
 #include "grammar.hpp"
+#include "comb.hpp"
 
 #include <iostream>
 #include <vector>
@@ -25,9 +26,12 @@ class Code
 
     /**
      * After solving for the all possible parse states of the grammar, call
-     * write to output the source code for the parse table.
+     * write to output the source code for the parse table.  If summary is
+     * given, the sizes of the packed tables are printed to it, and if stats
+     * is given, the sizes are counted there.
      */
-    static void write(const Grammar& grammar, std::ostream& out);
+    static void write(const Grammar& grammar, std::ostream& out,
+                      std::ostream* summary, Stats* stats);
 
   private:
     /**
@@ -62,11 +66,31 @@ class Code
     /**
      * Writes the actions for each state.  The actions determines if the parser
      * should shift the next terminal onto its stack or reduce the stack by a
-     * matched production rule.
+     * matched production rule.  Each state also names its default rule, or -1
+     * if it has none, which is reduced for any terminal without an action.
+     * The actions of every state are packed into single arrays that are
+     * indexed by the base of the state plus the id of the terminal, and states
+     * with the same actions share the same base.
      */
-    static void write_actions(std::vector<State*> states, ostream& out);
-    static void write_gotos(std::vector<State*> states, ostream& out);
-    static void write_states(std::vector<State*> states, ostream& out);
+    typedef std::pair<char, size_t> Action;
+    static void solve_actions(const std::vector<State*>& states,
+                              Comb<Action>* actions);
+    static void write_actions(const Comb<Action>& actions, ostream& out);
+    
+    /**
+     * Writes the gotos for each state, packed the same way as the actions.
+     * Since a goto is only looked up after a valid reduction, the most common
+     * next state of a nonterminal is its default and only the gotos to other
+     * states are packed.
+     */
+    static void solve_gotos(const std::vector<State*>& states,
+                            Comb<size_t>* gotos, std::vector<int>* defaults);
+    static void write_gotos(const Comb<size_t>& gotos,
+                            const std::vector<int>& defaults, ostream& out);
+    static void write_states(std::vector<State*> states,
+                             const Comb<Action>& actions,
+                             const Comb<size_t>& gotos, ostream& out);
+    static void write_numbers(const std::vector<int>& numbers, ostream& out);
 };
 
 #endif
@@ -0,0 +1,206 @@
+/*******************************************************************************
+ * Packs a sparse table, such as the actions or gotos of the parse states, into
+ * a few arrays that still find any entry in constant time.
+ */
+#ifndef comb_hpp
+#define comb_hpp
+
+#include <algorithm>
+#include <iostream>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+/*******************************************************************************
+ * Overlaps the rows of a table into a single array, like the teeth of combs
+ * pushed into each other.  Each row is given a base, and the entry for a column
+ * is found at the base plus the column.  The check array holds the column of
+ * each entry, so a lookup is two array reads: the entry is present only if the
+ * check at that index is the column.  Every row has a different base, so an
+ * entry of one row is never found by another row.  A row without entries has
+ * no base and is given -1.  The arrays are padded so that the base of any row
+ * plus any column is within the arrays.  Rows with the same entries are only
+ * placed once and share the same base.
+ */
+template <typename T>
+class Comb
+{
+  public:
+    Comb(size_t columns);
+
+    /** Each row is a list of columns and their entries. */
+    typedef std::vector<std::pair<size_t, T>> Row;
+
+    /** Adds a row to be packed and returns its index. */
+    size_t add(Row row);
+
+    /** Places the rows with the most entries first, each at the lowest fit. */
+    void solve();
+    size_t count_entries() const;
+
+    int base(size_t row) const;
+    std::vector<int> check;
+    std::vector<T> next;
+
+    /** Prints the size of the packed arrays compared to the full table. */
+    void print(const std::string& name, std::ostream& out) const;
+
+  private:
+    size_t columns;
+    size_t entries;
+    std::vector<Row> rows;
+    std::vector<int> bases;
+    std::vector<size_t> added;
+    std::map<Row, size_t> interned;
+    std::vector<bool> used;
+
+    bool fits(const Row& row, size_t base) const;
+    void place(const Row& row, size_t base);
+};
+
+/******************************************************************************/
+template <typename T>
+Comb<T>::Comb(size_t columns):
+    columns (columns),
+    entries (0){}
+
+template <typename T>
+size_t
+Comb<T>::add(Row row)
+{
+    struct {
+        bool operator()(const std::pair<size_t, T>& a,
+                        const std::pair<size_t, T>& b) const {
+            return a.first < b.first;
+        }
+    } compare;
+
+    std::sort(row.begin(), row.end(), compare);
+    entries += row.size();
+    
+    auto found = interned.find(row);
+    if (found == interned.end()) {
+        found = interned.insert({row, rows.size()}).first;
+        rows.push_back(std::move(row));
+        bases.push_back(-1);
+    }
+    added.push_back(found->second);
+    return added.size() - 1;
+}
+
+
+/**
+ * The search for a base starts before the first empty slot, since every slot
+ * before it is already taken.  Placing the rows with the most entries first
+ * leaves the smaller rows to fill the gaps between them.
+ */
+template <typename T>
+void
+Comb<T>::solve()
+{
+    std::vector<size_t> order;
+    for (size_t i = 0; i < rows.size(); i++) {
+        if (rows[i].size() > 0) {
+            order.push_back(i);
+        }
+    }
+    struct {
+        const std::vector<Row>* rows;
+        bool operator()(size_t a, size_t b) const {
+            if ((*rows)[a].size() != (*rows)[b].size()) {
+                return (*rows)[a].size() > (*rows)[b].size();
+            }
+            return a < b;
+        }
+    } compare;
+    compare.rows = &rows;
+    std::sort(order.begin(), order.end(), compare);
+
+    size_t empty = 0;
+    for (size_t i : order) {
+        const Row& row = rows[i];
+        while (empty < check.size() && check[empty] >= 0) {
+            empty++;
+        }
+        size_t base = 0;
+        if (empty > row.front().first) {
+            base = empty - row.front().first;
+        }
+        while (!fits(row, base)) {
+            base++;
+        }
+        place(row, base);
+        bases[i] = (int)base;
+    }
+
+    size_t size = used.size() + columns;
+    check.resize(size, -1);
+    next.resize(size, T());
+}
+
+template <typename T>
+bool
+Comb<T>::fits(const Row& row, size_t base) const
+{
+    if (base < used.size() && used[base]) {
+        return false;
+    }
+    for (auto& entry : row) {
+        size_t index = base + entry.first;
+        if (index < check.size() && check[index] >= 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+template <typename T>
+void
+Comb<T>::place(const Row& row, size_t base)
+{
+    if (base >= used.size()) {
+        used.resize(base + 1, false);
+    }
+    used[base] = true;
+
+    for (auto& entry : row) {
+        size_t index = base + entry.first;
+        if (index >= check.size()) {
+            check.resize(index + 1, -1);
+            next.resize(index + 1, T());
+        }
+        check[index] = (int)entry.first;
+        next[index] = entry.second;
+    }
+}
+
+template <typename T>
+size_t
+Comb<T>::count_entries() const {
+    return entries;
+}
+
+template <typename T>
+int
+Comb<T>::base(size_t row) const {
+    return bases[added[row]];
+}
+
+template <typename T>
+void
+Comb<T>::print(const std::string& name, std::ostream& out) const
+{
+    size_t full = added.size() * columns;
+    out << name << ": " << entries << " entries in ";
+    out << added.size() << " rows of " << columns << " columns, ";
+    out << rows.size() << " unique, ";
+    out << check.size() << " of " << full << " slots";
+    if (check.size() > 0) {
+        size_t ratio = full * 10 / check.size();
+        out << " (" << ratio / 10 << "." << ratio % 10 << " to 1)";
+    }
+    out << "\n";
+}
+
+#endif
@@ -0,0 +1,115 @@
+#include "digraph.hpp"
+
+#include <chrono>
+#include <limits>
+
+/******************************************************************************/
+Digraph::Digraph(size_t count):
+    sets        (count),
+    relations   (count),
+    depth       (count, 0),
+    last        (0){}
+
+void
+Digraph::relate(size_t from, size_t to) {
+    relations[from].push_back(to);
+}
+
+void
+Digraph::solve()
+{
+    components.clear();
+    last = elapsed();
+    for (size_t node = 0; node < sets.size(); node++) {
+        if (depth[node] == 0) {
+            traverse(node);
+        }
+    }
+}
+
+/**
+ * Each node is marked with its depth on the stack when first visited.  After
+ * visiting the related nodes, a node that can reach a node lower on the stack
+ * takes that lower depth.  If the depth of a node is unchanged, it is the root
+ * of a component and every node above it on the stack shares its set.  Solved
+ * nodes are marked with the largest depth so they never lower another node.
+ */
+void
+Digraph::traverse(size_t node)
+{
+    stack.push_back(node);
+    size_t mark = stack.size();
+    depth[node] = mark;
+
+    for (size_t next : relations[node]) {
+        if (depth[next] == 0) {
+            traverse(next);
+        }
+        if (depth[next] < depth[node]) {
+            depth[node] = depth[next];
+        }
+        sets[node].insert(sets[next]);
+    }
+
+    if (depth[node] == mark) {
+        Component component = {0, 0, 0};
+        while (true) {
+            size_t top = stack.back();
+            stack.pop_back();
+            depth[top] = std::numeric_limits<size_t>::max();
+            if (top != node) {
+                sets[top] = sets[node];
+            }
+            component.nodes++;
+            component.relations += relations[top].size();
+            if (top == node) {
+                break;
+            }
+        }
+        double now = elapsed();
+        component.seconds = now - last;
+        last = now;
+        components.push_back(component);
+    }
+}
+
+double
+Digraph::elapsed()
+{
+    auto now = std::chrono::steady_clock::now().time_since_epoch();
+    return std::chrono::duration<double>(now).count();
+}
+
+/**
+ * Prints the totals and then each component with more than one node, as those
+ * are the components that would have required repeated passes to solve.
+ */
+void
+Digraph::print(const std::vector<Component>& components, std::ostream& out)
+{
+    size_t relations = 0;
+    size_t largest = 0;
+    double seconds = 0;
+    for (auto& component : components) {
+        relations += component.relations;
+        seconds += component.seconds;
+        if (component.nodes > largest) {
+            largest = component.nodes;
+        }
+    }
+
+    out << components.size() << " components, ";
+    out << relations << " relations, ";
+    out << "largest " << largest << ", ";
+    out << seconds * 1000 << " ms\n";
+
+    for (size_t i = 0; i < components.size(); i++) {
+        const Component& component = components[i];
+        if (component.nodes > 1) {
+            out << "  component " << i << ": ";
+            out << component.nodes << " nodes, ";
+            out << component.relations << " relations, ";
+            out << component.seconds * 1000 << " ms\n";
+        }
+    }
+}
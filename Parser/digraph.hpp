@@ -0,0 +1,52 @@
+/*******************************************************************************
+ * Solves for sets defined over a directed graph.  The set of each node is its
+ * own initial set combined with the sets of every node that it relates to.  The
+ * firsts and follows of the nonterminals are both defined this way.
+ */
+#ifndef digraph_hpp
+#define digraph_hpp
+
+#include "bitset.hpp"
+
+#include <vector>
+#include <iostream>
+
+/*******************************************************************************
+ * Implements the digraph algorithm of DeRemer and Pennello.  A depth first
+ * traversal finds the strongly connected components of the graph, and all nodes
+ * within a component share the same set.  Each relation is followed only once,
+ * so the sets are solved in a single pass instead of repeating until no set
+ * changes.
+ */
+class Digraph
+{
+  public:
+    Digraph(size_t count);
+
+    /** Defines the initial sets and relations before solving. */
+    std::vector<Bitset> sets;
+    void relate(size_t from, size_t to);
+
+    void solve();
+
+    /** Work done and time spent for each component, in the order solved. */
+    struct Component {
+        size_t nodes;
+        size_t relations;
+        double seconds;
+    };
+    std::vector<Component> components;
+    static void print(const std::vector<Component>& components,
+                      std::ostream& out);
+
+  private:
+    std::vector<std::vector<size_t>> relations;
+    std::vector<size_t> depth;
+    std::vector<size_t> stack;
+
+    void traverse(size_t node);
+    double elapsed();
+    double last;
+};
+
+#endif
@@ -1,5 +1,7 @@
 #include "display.hpp"
 
+#include <algorithm>
+
 /******************************************************************************/
 void
 Display::print(const Lexer& lexer, std::ostream& out)
@@ -27,8 +29,8 @@ Display::print(const Node& state, std::ostream& out)
 void
 Display::print(const Node::Range& range, std::ostream& out)
 {
-    char first = range.first;
-    char last  = range.last;
+    int first = range.first;
+    int last  = range.last;
     
     if (first == last) {
         if (isprint(first) && first != '\'') {
@@ -51,8 +53,8 @@ void
 Display::print(const Grammar& grammar, std::ostream& out)
 {
     std::vector<State*> states;
-    for (auto& state : grammar.states) {
-        states.push_back(state.get());
+    for (State* state : grammar.states) {
+        states.push_back(state);
     }
     struct {
         bool operator()(State* a, State* b) const { return a->id < b->id; }
@@ -125,6 +127,10 @@ Display::print_action(const Symbol* symbol, State::Actions* actions, std::ostrea
         out << "a" << accept->second->id << " ";
         return;
     }
+    if (actions->reduce_default && actions->error.count(symbol) == 0) {
+        out << "r" << actions->reduce_default->id << " ";
+        return;
+    }
     out << "   ";
 }
 
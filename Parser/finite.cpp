@@ -1,23 +1,38 @@
 #include "finite.hpp"
 
+#include <algorithm>
+
+/******************************************************************************/
+Symbol::Symbol(Kind kind):
+    kind(kind),
+    id(0){}
+
 /******************************************************************************/
 Term::Term(const std::string& name, size_t rank):
+    Symbol(TERM),
     name(name),
-    rank(rank){}
+    rank(rank),
+    precedence(0),
+    assoc(NONE){}
 
 void Term::print(std::ostream& out) const { out << "'" << name << "'"; }
 void Term::write(std::ostream& out) const { out << "term" << rank; }
 
 /******************************************************************************/
+Endmark::Endmark():
+    Symbol(ENDMARK){}
+
 void Endmark::print(std::ostream& out) const { out << "$"; }
 void Endmark::write(std::ostream& out) const { out << "endmark"; }
 
 /******************************************************************************/
-Finite::Finite():
-    accept(nullptr){}
+Finite::Finite(Arena<Out>* arena):
+    accept(nullptr),
+    arena(arena){}
 
-Finite::Finite(Term* accept):
-    accept(accept){}
+Finite::Finite(Arena<Out>* arena, Term* accept):
+    accept(accept),
+    arena(arena){}
 
 /**
  * Simulates a NFA.  Will continually read from an input stream, following
@@ -34,7 +49,7 @@ Finite::scan(std::istream* in)
     closure(&current);
     
     while (in->peek() != EOF) {
-        char c = in->peek();
+        int c = in->peek();
         for (Finite* state : current) {
             state->move(c, &found);
         }
@@ -87,7 +102,7 @@ Finite::closure(std::set<Finite*>* states, std::vector<Finite*>* stack) const
 }
 
 void
-Finite::move(char c, std::set<Finite*>* next) const
+Finite::move(int c, std::set<Finite*>* next) const
 {
     for (auto& out : outs) {
         if (out->in_range(c) && out->next) {
@@ -110,63 +125,52 @@ Finite::lower_rank(const Finite* left, const Finite* right)
 
 /** Builds and returns new outputs, but retains ownership. */
 Finite::Out*
-Finite::add_out(char c, Finite* next) {
-    outs.emplace_back(std::make_unique<Out>(c, c, next));
-    return outs.back().get();
-}
-
-Finite::Out*
-Finite::add_out(char first, char last, Finite* next) {
-    outs.emplace_back(std::make_unique<Out>(first, last, next));
-    return outs.back().get();
+Finite::add_out(int c, Finite* next) {
+    outs.push_back(arena->make(c, c, next));
+    return outs.back();
 }
 
 Finite::Out*
-Finite::add_not(char first, char last, Finite* next) {
-    outs.emplace_back(std::make_unique<Out>(first, last, false, next));
-    return outs.back().get();
+Finite::add_out(int first, int last, Finite* next) {
+    outs.push_back(arena->make(first, last, next));
+    return outs.back();
 }
 
 Finite::Out*
 Finite::add_epsilon(Finite* next) {
-    outs.emplace_back(std::make_unique<Out>(next));
-    return outs.back().get();
+    outs.push_back(arena->make(next));
+    return outs.back();
 }
 
 /******************************************************************************/
-Finite::Out::Out(char first, char last, Finite* next):
-    next    (next),
-    epsilon (false),
-    inside  (true),
-    first   (first),
-    last    (last){}
-
-Finite::Out::Out(char first, char last, bool inside, Finite* next):
+Finite::Out::Out(int first, int last, Finite* next):
     next    (next),
     epsilon (false),
-    inside  (inside),
     first   (first),
     last    (last){}
 
 Finite::Out::Out(Finite* next):
     next    (next),
     epsilon (true),
-    inside  (true),
-    first   ('\0'),
-    last    ('\0'){}
+    first   (0),
+    last    (0){}
 
 bool
 Finite::Out::is_epsilon() {
     return epsilon;
 }
 
-bool
-Finite::Out::in_range(char c) {
-    if (epsilon) {
-        return false;
-    } else if (inside) {
-        return (c >= first && c <= last);
-    } else {
-        return (c < first || c > last);
+/** Characters between two bounds are either all inside or all outside. */
+void
+Finite::Out::bounds(std::set<int>* starts) const
+{
+    if (!epsilon) {
+        starts->insert(first);
+        starts->insert(last + 1);
     }
 }
+
+bool
+Finite::Out::in_range(int c) {
+    return !epsilon && c >= first && c <= last;
+}
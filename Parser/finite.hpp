@@ -8,6 +8,8 @@
 #ifndef finite_hpp
 #define finite_hpp
 
+#include "arena.hpp"
+
 #include <set>
 #include <string>
 #include <vector>
@@ -15,12 +17,20 @@
 #include <iostream>
 
 /*******************************************************************************
- * Base class for all types of symbols such as terminals and nonterminals.
+ * Base class for all types of symbols such as terminals and nonterminals.  The
+ * terminals, including the endmark, and the nonterminals are each numbered
+ * densely as they are read so that sets of symbols can be stored as bits.  The
+ * kind of each symbol is stored so the solving loops can check the type of a
+ * symbol with an integer compare instead of a dynamic cast.
  */
 class Symbol
 {
   public:
+    enum Kind { TERM, NONTERM, ENDMARK };
+    Symbol(Kind kind);
+    const Kind kind;
     std::string type;
+    size_t id;
     virtual void print(std::ostream& out) const = 0;
     virtual void write(std::ostream& out) const = 0;
 };
@@ -38,8 +48,26 @@ class Term : public Symbol
     std::string name;
     size_t rank;
     
+    /** Returns the symbol as a terminal, or null for other kinds. */
+    static Term* cast(Symbol* symbol) {
+        if (symbol && symbol->kind == TERM) {
+            return static_cast<Term*>(symbol);
+        } else {
+            return nullptr;
+        }
+    }
+    
     std::string action;
     
+    /**
+     * Precedence and associativity given by a declaration, which resolve
+     * shift/reduce conflicts.  Later declarations have higher precedence and
+     * zero means the terminal has no declared precedence.
+     */
+    enum Assoc { NONE, LEFT, RIGHT, NONASSOC };
+    size_t precedence;
+    Assoc assoc;
+    
     virtual void print(std::ostream& out) const;
     virtual void write(std::ostream& out) const;
 };
@@ -50,6 +78,7 @@ class Term : public Symbol
 class Endmark : public Symbol
 {
   public:
+    Endmark();
     virtual void print(std::ostream& out) const;
     virtual void write(std::ostream& out) const;
 };
@@ -57,12 +86,14 @@ class Endmark : public Symbol
 /*******************************************************************************
  * State in the finite automata.  Each state contains an array of outputs that
  * determines the next states to move to after reading an input character.  The
- * presences of an accept pointer indicates a match when in this state.
+ * presences of an accept pointer indicates a match when in this state.  The
+ * outputs are built in an arena shared by all states of the same automaton.
  */
 class Finite {
   public:
-    Finite();
-    Finite(Term* accept);
+    class Out;
+    Finite(Arena<Out>* arena);
+    Finite(Arena<Out>* arena, Term* accept);
     Term* accept;
 
     /** Checks an input stream for a pattern starting from this state. */
@@ -70,34 +101,35 @@ class Finite {
     
     /**
      * Each state contains an array of outputs that determine the next states
-     * to move to after reading an input character.  Empty outputs, epsilon
-     * transitions, are allowed and are useful for passing by optional states.
+     * to move to after reading an input byte, from 0 to 255.  Empty outputs,
+     * epsilon transitions, are allowed and are useful for passing by optional
+     * states.
      */
     class Out {
       public:
-        Out(char first, char last, Finite* next);
-        Out(char first, char last, bool inside, Finite* next);
+        Out(int first, int last, Finite* next);
         Out(Finite* next);
         
         Finite* next;
         bool is_epsilon();
-        bool in_range(char c);
+        bool in_range(int c);
+        
+        /** Adds the first character of the range and the one after it. */
+        void bounds(std::set<int>* starts) const;
         
       private:
         bool epsilon;
-        bool inside;
-        char first;
-        char last;
+        int first;
+        int last;
     };
     
     /** Builds and returns new outputs, but retains ownership. */
-    Out* add_out(char c, Finite* next);
-    Out* add_out(char first, char last, Finite* next);
-    Out* add_not(char first, char last, Finite* next);
+    Out* add_out(int c, Finite* next);
+    Out* add_out(int first, int last, Finite* next);
     Out* add_epsilon(Finite* next);
         
     /** Finds output targets with the given character in its range. */
-    void move(char c, std::set<Finite*>* next) const;
+    void move(int c, std::set<Finite*>* next) const;
     
     /** Follows empty transitions until no new states are found. */
     static void closure(std::set<Finite*>* states);
@@ -106,7 +138,8 @@ class Finite {
     static bool lower_rank(const Finite* left, const Finite* right);
     
   private:
-    std::vector<std::unique_ptr<Out>> outs;
+    Arena<Out>* arena;
+    std::vector<Out*> outs;
 };
 
 #endif
@@ -1,6 +1,12 @@
 #include "grammar.hpp"
 
+#include "parallel.hpp"
+#include "digraph.hpp"
+
 #include <iostream>
+#include <sstream>
+#include <algorithm>
+#include <cstdint>
 
 using std::string;
 using std::vector;
@@ -9,7 +15,16 @@ using std::make_unique;
 
 /******************************************************************************/
 Grammar::Grammar():
-    start(nullptr){}
+    method(CANONICAL),
+    threads(1),
+    skip_units(false),
+    conflicts(0),
+    start(nullptr),
+    precedences(0)
+{
+    endmark.id = all_terms.size();
+    all_terms.push_back(&endmark);
+}
 
 bool
 Grammar::read_grammar(std::istream& in)
@@ -34,6 +49,11 @@ Grammar::read_grammar(std::istream& in)
                 return false;
             }
         }
+        else if (in.peek() == '%') {
+            if (!read_precedence(in)) {
+                return false;
+            }
+        }
         else {
             if (!read_rules(in)) {
                 return false;
@@ -44,6 +64,21 @@ Grammar::read_grammar(std::istream& in)
 }
 
 /******************************************************************************/
+void
+Grammar::solve_lexer()
+{
+    stats.start("lexer_solve");
+    lexer.solve();
+    stats.count("nfa_states", lexer.count_finites());
+    stats.count("char_classes", lexer.classes.size());
+    stats.count("dfa_nodes", lexer.nodes.size());
+    
+    stats.start("lexer_reduce");
+    lexer.reduce();
+    stats.count("dfa_nodes_minimized", lexer.nodes.size());
+    stats.stop();
+}
+
 void
 Grammar::solve_states()
 {
@@ -51,62 +86,460 @@ Grammar::solve_states()
         return;
     }
     
-    lexer.solve();
-    
+    stats.start("solve_first");
     solve_first();
+    stats.start("solve_follows");
     solve_follows(&endmark);
     
-    auto state = std::make_unique<State>(states.size());
-    state->add(State::Item(all.front()->rules.front().get(), 0, &endmark));
-    state->closure();
+    stats.start("solve_states");
+    State state(states.size());
+    state.add(State::Item(all.front()->rules.front(), 0), endmark.id);
+    
+    if (threads > 1) {
+        solve_parallel(std::move(state));
+    } else {
+        solve_serial(std::move(state));
+    }
     
-    start = state.get();
-    states.insert(std::move(state));
+    size_t items = 0;
+    for (State* state : states) {
+        items += state->count_items();
+    }
+    stats.count("lr_states", states.size());
+    stats.count("lr_items", items);
+    stats.count("closure_lookups", closures.hits + closures.misses);
+    stats.count("closure_hits", closures.hits);
+
+    if (method == LALR || method == MINIMAL) {
+        stats.start("merge_states");
+        merge_states();
+        stats.count("lr_states_merged", states.size());
+    }
+
+    Nonterm::Rule* rule = all.front()->rules.front();
+    State::Item accept(rule, rule->product.size());
+
+    stats.start("solve_actions");
+    std::ostringstream report;
+    conflicts = 0;
+    for (State* state : states) {
+        conflicts += state->solve_actions(accept, endmark.id, all_terms,
+                                          report);
+        state->solve_gotos();
+    }
+    if (conflicts > 0) {
+        report << conflicts << " conflicts not resolved by precedence.\n";
+    }
+    conflict_report = report.str();
+    std::cerr << conflict_report;
     
+    if (skip_units) {
+        stats.start("skip_units");
+        skip_unit_rules();
+        stats.count("lr_states_skipped", states.size());
+    }
+    for (State* state : states) {
+        state->solve_default();
+    }
+    stats.count("conflicts", conflicts);
+    stats.stop();
+}
+
+/**
+ * Starting from the initial state, checks each found state for the next states
+ * after every possible symbol until no new states are found.
+ */
+void
+Grammar::solve_serial(State state)
+{
     std::vector<State*> checking;
-    checking.push_back(start);
+    start = intern(std::move(state), &checking);
 
     while (checking.size() > 0)
     {
         State* state = checking.back();
         checking.pop_back();
 
-        for (auto& term : terms) {
-            Symbol* sym = term.second.get();
-            std::unique_ptr<State> next = state->solve_next(sym, states.size());
-            if (next) {
-                auto found = states.insert(std::move(next));
-                State* target = found.first->get();
-                state->add_next(sym, target);
-                if (found.second) {
-                    checking.push_back(target);
+        State::Nexts nexts;
+        state->solve_nexts(&nexts);
+        for (auto& next : nexts) {
+            State* target = intern(std::move(next.second), &checking);
+            state->add_next(next.first, target);
+        }
+    }
+    interned.clear();
+}
+
+/**
+ * Checks the found states with a pool of worker threads.  Since the order in
+ * which the threads find the states varies, the states are numbered afterwards
+ * in the same order that checking them on a single thread would have found
+ * them.
+ */
+void
+Grammar::solve_parallel(State state)
+{
+    Workers workers(threads);
+    Interned table(threads * 16);
+    std::vector<State::Closures> caches(threads);
+
+    bool found = false;
+    start = table.intern(std::move(state), &caches[0], &found);
+    workers.push(0, start);
+    
+    workers.run([&](size_t worker, State* state) {
+        State::Nexts nexts;
+        state->solve_nexts(&nexts);
+        for (auto& next : nexts) {
+            bool found = false;
+            State* target = table.intern(std::move(next.second),
+                                         &caches[worker], &found);
+            state->add_next(next.first, target);
+            if (found) {
+                workers.push(worker, target);
+            }
+        }
+    });
+    
+    table.release(&state_arena, &states);
+    number_states();
+    
+    for (auto& cache : caches) {
+        closures.hits += cache.hits;
+        closures.misses += cache.misses;
+    }
+}
+
+/**
+ * Numbers the states by following the next states from the start state in the
+ * same order as solving the states on a single thread.
+ */
+void
+Grammar::number_states()
+{
+    std::vector<Symbol*> symbols(all_terms.begin(), all_terms.end());
+    symbols.resize(all_terms.size() + nonterms.size());
+    for (auto& nonterm : nonterms) {
+        symbols[all_terms.size() + nonterm.second->id] = nonterm.second.get();
+    }
+    
+    std::unordered_set<State*> numbered;
+    std::vector<State*> checking;
+    
+    size_t id = 0;
+    start->id = id++;
+    numbered.insert(start);
+    checking.push_back(start);
+    
+    while (checking.size() > 0) {
+        State* state = checking.back();
+        checking.pop_back();
+        
+        for (Symbol* sym : symbols) {
+            State* next = state->get_next(sym);
+            if (next && numbered.insert(next).second) {
+                next->id = id++;
+                checking.push_back(next);
+            }
+        }
+    }
+    
+    struct {
+        bool operator()(State* a, State* b) const {
+            return a->id < b->id;
+        }
+    } compare;
+    std::sort(states.begin(), states.end(), compare);
+}
+
+/**
+ * Returns the existing state with the same kernel or adds the new state.  Only
+ * newly found states are moved into the arena, closed and then checked for
+ * their next states.
+ */
+State*
+Grammar::intern(State state, std::vector<State*>* checking)
+{
+    state.solve_hash();
+    auto found = interned.find(&state);
+    if (found != interned.end()) {
+        return *found;
+    }
+    
+    state.id = states.size();
+    State* added = state_arena.make(std::move(state));
+    interned.insert(added);
+    added->closure(&closures);
+    checking->push_back(added);
+    states.push_back(added);
+    return added;
+}
+
+/**
+ * Groups the canonical LR(1) states by their cores and replaces each group with
+ * a single state.  The merged states are numbered in the order of the lowest
+ * state in each group so the start state remains the first state.  Merging
+ * never adds shift/reduce conflicts, but can reduce more than one rule for the
+ * same lookahead.  Those new conflicts are marked on the merged state, so they
+ * are reported once with the states they came from when solving the actions.
+ */
+void
+Grammar::merge_states()
+{
+    std::map<State::Core, std::vector<State*>> cores;
+    for (State* state : states) {
+        cores[state->core()].push_back(state);
+    }
+    
+    struct {
+        bool operator()(State* a, State* b) const {
+            return a->id < b->id;
+        }
+        bool operator()(const std::vector<State*>& a,
+                        const std::vector<State*>& b) const {
+            return a.front()->id < b.front()->id;
+        }
+    } compare;
+    
+    Groups groups;
+    for (auto& core : cores) {
+        std::vector<State*>& group = core.second;
+        std::sort(group.begin(), group.end(), compare);
+        groups.push_back(group);
+    }
+    
+    if (method == MINIMAL) {
+        divide_conflicts(&groups);
+        divide_nexts(&groups);
+    }
+    std::sort(groups.begin(), groups.end(), compare);
+    
+    std::map<State*, State*> replace;
+    Arena<State> arena;
+    std::vector<State*> merged;
+    for (auto& group : groups) {
+        State* state = arena.make(merged.size());
+        State::Reduces reduces;
+        std::set<size_t> existing;
+        for (State* member : group) {
+            State::Reduces own;
+            member->solve_reduces(&own);
+            for (auto& reduce : own) {
+                if (reduce.second.size() > 1) {
+                    existing.insert(reduce.first);
                 }
+                reduces[reduce.first].insert(reduce.second.begin(),
+                                             reduce.second.end());
+            }
+            state->merge(*member);
+            replace[member] = state;
+        }
+        for (auto& reduce : reduces) {
+            if (reduce.second.size() > 1 && existing.count(reduce.first) == 0) {
+                state->merge_conflicts.insert(reduce.first);
             }
         }
+        if (!state->merge_conflicts.empty()) {
+            for (State* member : group) {
+                state->merged.push_back(member->id);
+            }
+        }
+        merged.push_back(state);
+    }
+    
+    for (State* state : merged) {
+        state->replace(replace);
+    }
+    
+    start = replace[start];
+    states = merged;
+    state_arena = std::move(arena);
+}
 
-        for (auto& nonterm : nonterms) {
-            Symbol* sym = nonterm.second.get();
-            std::unique_ptr<State> next = state->solve_next(sym, states.size());
-            if (next) {
-                auto found = states.insert(std::move(next));
-                State* target = found.first->get();
-                state->add_next(sym, target);
-                if (found.second) {
-                    checking.push_back(target);
+/**
+ * Divides each group of states with the same core so that no state in a group
+ * reduces a different rule for a lookahead than any other state in the group,
+ * unless that conflict already exists within a single state.
+ */
+void
+Grammar::divide_conflicts(Groups* groups)
+{
+    Groups result;
+    for (auto& group : *groups) {
+        std::vector<State::Reduces> merged;
+        Groups divided;
+        for (State* state : group) {
+            State::Reduces reduces;
+            state->solve_reduces(&reduces);
+            
+            bool found = false;
+            for (size_t i = 0; i < divided.size(); i++) {
+                if (compatible(merged[i], reduces)) {
+                    for (auto& reduce : reduces) {
+                        merged[i][reduce.first].insert(reduce.second.begin(),
+                                                       reduce.second.end());
+                    }
+                    divided[i].push_back(state);
+                    found = true;
+                    break;
                 }
             }
+            if (!found) {
+                merged.push_back(reduces);
+                divided.push_back({state});
+            }
         }
+        result.insert(result.end(), divided.begin(), divided.end());
     }
+    *groups = result;
+}
 
-    Nonterm::Rule* rule = all.front()->rules.front().get();
-    State::Item accept(rule, rule->product.size(), &endmark);
+bool
+Grammar::compatible(const State::Reduces& group, const State::Reduces& state)
+{
+    for (auto& reduce : state) {
+        auto found = group.find(reduce.first);
+        if (found == group.end()) {
+            continue;
+        }
+        std::set<Nonterm::Rule*> rules = found->second;
+        rules.insert(reduce.second.begin(), reduce.second.end());
+        if (rules.size() > 1 && rules != found->second
+                && rules != reduce.second) {
+            return false;
+        }
+    }
+    return true;
+}
 
-    for (auto& state : states) {
-        state->solve_actions(accept);
-        state->solve_gotos();
+/**
+ * Merged states must have a single next state for each symbol, so states are
+ * divided until every state of a group moves to the same groups.  Similar to
+ * minimizing the lexer, dividing continues until no group changes.
+ */
+void
+Grammar::divide_nexts(Groups* groups)
+{
+    bool found = true;
+    while (found) {
+        found = false;
+        
+        std::map<State*, size_t> index;
+        for (size_t i = 0; i < groups->size(); i++) {
+            for (State* state : (*groups)[i]) {
+                index[state] = i;
+            }
+        }
+        
+        Groups result;
+        for (auto& group : *groups) {
+            std::map<std::vector<size_t>, std::vector<State*>> divided;
+            for (State* state : group) {
+                std::vector<size_t> targets;
+                for (State* next : state->next_states()) {
+                    targets.push_back(index[next]);
+                }
+                divided[targets].push_back(state);
+            }
+            if (divided.size() > 1) {
+                found = true;
+            }
+            for (auto& divide : divided) {
+                result.push_back(divide.second);
+            }
+        }
+        *groups = result;
     }
 }
 
+/******************************************************************************/
+/**
+ * The nonterminal must have the same type as the symbol, or no type, for the
+ * value of the symbol to be passed through.
+ */
+bool
+Grammar::is_unit(const Nonterm::Rule* rule)
+{
+    if (rule->product.size() != 1 || !rule->action.empty()) {
+        return false;
+    }
+    const std::string& type = rule->nonterm->type;
+    return type.empty() || type == rule->product.front()->type;
+}
+
+/**
+ * Since a state that only reduces a unit rule A : B never shifts, moving to it
+ * on B and then reducing to A is the same as moving directly to the state after
+ * A.  The value of B is left on the stack as the value of A.  Lookaheads that
+ * the skipped state would have rejected are instead rejected by a later state.
+ */
+void
+Grammar::skip_unit_rules()
+{
+    for (State* state : states) {
+        for (auto& shift : state->actions->shift) {
+            shift.second = skip_chain(state, shift.second);
+        }
+        for (auto& go : state->gotos) {
+            go.second = skip_chain(state, go.second);
+        }
+    }
+    remove_unreached();
+}
+
+/** Follows a chain of unit rules, with at most one step for each state. */
+State*
+Grammar::skip_chain(State* from, State* next) const
+{
+    for (size_t i = 0; i < states.size(); i++) {
+        Nonterm::Rule* rule = next->only_reduce();
+        if (!rule || !is_unit(rule)) {
+            break;
+        }
+        auto found = from->gotos.find(rule->nonterm);
+        if (found == from->gotos.end()) {
+            break;
+        }
+        next = found->second;
+    }
+    return next;
+}
+
+/** Keeps the states reached from the start state, numbered in order. */
+void
+Grammar::remove_unreached()
+{
+    std::unordered_set<State*> reached;
+    std::vector<State*> checking;
+    reached.insert(start);
+    checking.push_back(start);
+    
+    while (checking.size() > 0) {
+        State* state = checking.back();
+        checking.pop_back();
+        
+        for (auto& shift : state->actions->shift) {
+            if (reached.insert(shift.second).second) {
+                checking.push_back(shift.second);
+            }
+        }
+        for (auto& go : state->gotos) {
+            if (reached.insert(go.second).second) {
+                checking.push_back(go.second);
+            }
+        }
+    }
+    
+    std::vector<State*> kept;
+    for (State* state : states) {
+        if (reached.count(state) > 0) {
+            state->id = kept.size();
+            kept.push_back(state);
+        }
+    }
+    states = kept;
+}
+
 /******************************************************************************/
 void
 Grammar::print_grammar(std::ostream& out) const
@@ -119,32 +552,51 @@ Grammar::print_grammar(std::ostream& out) const
     
     out << "Firsts:\n";
     for (auto nonterm : all) {
-        nonterm->print_firsts(out);
+        nonterm->print_firsts(out, all_terms);
         out << std::endl;
     }
     out << std::endl;
     
     out << "Follows:\n";
     for (auto nonterm : all) {
-        nonterm->print_follows(out);
+        nonterm->print_follows(out, all_terms);
         out << std::endl;
     }
     out << std::endl;
 }
 
+void
+Grammar::print_summary(std::ostream& out) const
+{
+    out << "States: " << states.size() << "\n";
+    
+    size_t total = closures.hits + closures.misses;
+    out << "Closures: " << closures.hits << " hits, ";
+    out << closures.misses << " misses";
+    if (total > 0) {
+        out << " (" << closures.hits * 100 / total << "% hits)";
+    }
+    out << "\n";
+    
+    out << "Firsts: ";
+    Digraph::print(first_components, out);
+    out << "Follows: ";
+    Digraph::print(follow_components, out);
+}
+
 void
 Grammar::print_states(std::ostream& out) const
 {
     for (auto& state : states) {
         state->print(out);
-        state->print_items(out);
+        state->print_items(out, all_terms);
         out << std::endl;
     }
 }
 
 /******************************************************************************/
 Term*
-Grammar::intern_term(std::istream& in)
+Grammar::intern_term(std::istream& in, bool literal)
 {
     string name;
     if (!read_term_name(in, &name)) {
@@ -153,9 +605,15 @@ Grammar::intern_term(std::istream& in)
     if (terms.count(name) == 0) {
         terms[name] = std::make_unique<Term>(name, terms.size());
         Term* term = terms[name].get();
+        term->id = all_terms.size();
+        all_terms.push_back(term);
+    }
+    Term* term = terms[name].get();
+    if (literal && patterned.count(term) == 0) {
+        patterned.insert(term);
         lexer.add_literal(term, name);
     }
-    return terms[name].get();
+    return term;
 }
 
 Nonterm*
@@ -167,6 +625,7 @@ Grammar::intern_nonterm(istream& in)
     }
     if (nonterms.count(name) == 0) {
         nonterms[name] = make_unique<Nonterm>(name);
+        nonterms[name]->id = nonterms.size() - 1;
     }
     return nonterms[name].get();
 }
@@ -200,6 +659,8 @@ Grammar::read_term(istream& in)
         
     if (terms.count(name) == 0) {
         terms[name] = make_unique<Term>(name, terms.size());
+        terms[name]->id = all_terms.size();
+        all_terms.push_back(terms[name].get());
     }
     Term* term = terms[name].get();
     term->type = type;
@@ -210,6 +671,7 @@ Grammar::read_term(istream& in)
     } else {
         lexer.add_literal(term, term->name);
     }
+    patterned.insert(term);
 
     return true;
 }
@@ -234,6 +696,7 @@ Grammar::read_rules(istream& in)
     
     if (nonterms.count(name) == 0) {
         nonterms[name] = make_unique<Nonterm>(name);
+        nonterms[name]->id = nonterms.size() - 1;
     }
     Nonterm* nonterm = nonterms[name].get();
     nonterm->type = type;
@@ -241,9 +704,10 @@ Grammar::read_rules(istream& in)
     all.push_back(nonterm);
     
     vector<Symbol*> syms;
+    Term* prec = nullptr;
         
     while (in.peek() != EOF) {
-        if (!read_product(in, &syms)) {
+        if (!read_product(in, &syms, &prec)) {
             return false;
         }
         string action;
@@ -254,24 +718,27 @@ Grammar::read_rules(istream& in)
         in >> std::ws;
         if (in.peek() == ';') {
             in.get();
-            Nonterm::Rule* rule = nonterm->add_rule(syms, action);
+            Nonterm::Rule* rule = nonterm->add_rule(&rule_arena, syms, action);
             rule->id = all_rules.size();
+            rule->prec = prec;
             all_rules.push_back(rule);
             break;
         }
         else if (in.peek() == '|') {
             in.get();
-            Nonterm::Rule* rule = nonterm->add_rule(syms, action);
+            Nonterm::Rule* rule = nonterm->add_rule(&rule_arena, syms, action);
             rule->id = all_rules.size();
+            rule->prec = prec;
             all_rules.push_back(rule);
             syms.clear();
+            prec = nullptr;
         }
     }
     return true;
 }
 
 bool
-Grammar::read_product(istream& in, vector<Symbol*>* syms)
+Grammar::read_product(istream& in, vector<Symbol*>* syms, Term** prec)
 {
     while (in.peek() != EOF) {
         in >> std::ws;
@@ -282,7 +749,7 @@ Grammar::read_product(istream& in, vector<Symbol*>* syms)
         
         int c = in.peek();
         if (c == '\'') {
-            Term* sym = intern_term(in);
+            Term* sym = intern_term(in, true);
             if (sym) {
                 syms->push_back(sym);
             } else {
@@ -295,6 +762,21 @@ Grammar::read_product(istream& in, vector<Symbol*>* syms)
             } else {
                 return false;
             }
+        } else if (c == '%') {
+            in.get();
+            string word;
+            while (isalpha(in.peek())) {
+                word.push_back(in.get());
+            }
+            if (word != "prec") {
+                std::cerr << "Expected %prec in rule.\n";
+                return false;
+            }
+            in >> std::ws;
+            *prec = intern_term(in, false);
+            if (!*prec) {
+                return false;
+            }
         } else {
             std::cerr << "Expected character in rule.\n";
             return false;
@@ -303,6 +785,52 @@ Grammar::read_product(istream& in, vector<Symbol*>* syms)
     return true;
 }
 
+/**
+ * Reads a %left, %right or %nonassoc declaration and the terminals it lists.
+ * Each declaration has a higher precedence than the declarations before it.
+ */
+bool
+Grammar::read_precedence(istream& in)
+{
+    in.get();
+    string word;
+    while (isalpha(in.peek())) {
+        word.push_back(in.get());
+    }
+    
+    Term::Assoc assoc = Term::NONE;
+    if (word == "left") {
+        assoc = Term::LEFT;
+    } else if (word == "right") {
+        assoc = Term::RIGHT;
+    } else if (word == "nonassoc") {
+        assoc = Term::NONASSOC;
+    } else {
+        std::cerr << "Unknown declaration '%" << word << "'.\n";
+        return false;
+    }
+    precedences++;
+    
+    while (true) {
+        in >> std::ws;
+        if (in.peek() == ';') {
+            in.get();
+            break;
+        }
+        if (in.peek() != '\'') {
+            std::cerr << "Precedence declarations list terminals.\n";
+            return false;
+        }
+        Term* term = intern_term(in, false);
+        if (!term) {
+            return false;
+        }
+        term->precedence = precedences;
+        term->assoc = assoc;
+    }
+    return true;
+}
+
 bool
 Grammar::read_include(istream& in)
 {
@@ -367,7 +895,7 @@ Grammar::read_term_name(istream& in, string* name)
         std::cerr << "Expected quote to start terminal name.\n";
         return false;
     }
-    while (isprint(in.peek()) && in.peek() != '\'') {
+    while ((isprint(in.peek()) || in.peek() >= 0x80) && in.peek() != '\'') {
         name->push_back(in.get());
     }
     if (in.get() != '\'') {
@@ -437,7 +965,7 @@ Grammar::read_regex(istream& in, string* regex)
             break;
         }
 
-        if (isprint(c)) {
+        if (isprint(c) || c >= 0x80) {
             regex->push_back(in.get());
         } else {
             std::cerr << "Unexpected character in regular expression.\n";
@@ -490,34 +1018,125 @@ Grammar::read_action(istream& in, string* action)
 }
 
 /******************************************************************************/
+/**
+ * Solves which nonterminals can derive the empty string.  Each rule counts its
+ * symbols that are not yet known to be empty.  When a nonterminal is found to
+ * be empty, the count of each rule using it is reduced, and a rule whose count
+ * reaches zero makes its own nonterminal empty.
+ */
+void
+Grammar::solve_empty()
+{
+    std::vector<size_t> counts(all_rules.size(), 0);
+    std::vector<std::vector<Nonterm::Rule*>> uses(nonterms.size());
+    std::vector<Nonterm*> found;
+    
+    for (auto rule : all_rules) {
+        bool terminal = false;
+        for (auto sym : rule->product) {
+            Nonterm* nonterm = Nonterm::cast(sym);
+            if (nonterm) {
+                uses[nonterm->id].push_back(rule);
+            } else {
+                terminal = true;
+            }
+        }
+        counts[rule->id] = terminal ? SIZE_MAX : rule->product.size();
+        if (counts[rule->id] == 0 && !rule->nonterm->empty_first) {
+            rule->nonterm->empty_first = true;
+            found.push_back(rule->nonterm);
+        }
+    }
+    
+    while (found.size() > 0) {
+        Nonterm* nonterm = found.back();
+        found.pop_back();
+        for (auto rule : uses[nonterm->id]) {
+            if (counts[rule->id] != SIZE_MAX && --counts[rule->id] == 0
+                    && !rule->nonterm->empty_first) {
+                rule->nonterm->empty_first = true;
+                found.push_back(rule->nonterm);
+            }
+        }
+    }
+}
+
+/**
+ * The firsts of a nonterminal include the firsts of every nonterminal that
+ * starts one of its rules, after skipping any empty nonterminals.
+ */
 void
 Grammar::solve_first()
 {
-    bool found = false;
-    do {
-        found = false;
-        for (auto& nonterm : nonterms) {
-            nonterm.second->solve_first(&found);
+    solve_empty();
+    
+    Digraph graph(nonterms.size());
+    for (auto rule : all_rules) {
+        size_t node = rule->nonterm->id;
+        for (auto sym : rule->product) {
+            Nonterm* nonterm = Nonterm::cast(sym);
+            if (nonterm) {
+                graph.relate(node, nonterm->id);
+                if (!nonterm->empty_first) {
+                    break;
+                }
+            } else {
+                graph.sets[node].insert(sym->id);
+                break;
+            }
         }
-    } while (found);
+    }
+    graph.solve();
+    
+    for (auto& nonterm : nonterms) {
+        nonterm.second->firsts = graph.sets[nonterm.second->id];
+    }
+    first_components = graph.components;
 }
 
+/**
+ * The follows of a nonterminal include the firsts of the symbols after it in
+ * each rule, and if those symbols can be empty, the follows of the rule's own
+ * nonterminal.
+ */
 void
 Grammar::solve_follows(Symbol* endmark)
 {
     if (all.size() == 0 || all.front()->rules.size() == 0) {
         return;
     }
-        
-    Nonterm::Rule* rule = all.front()->rules.front().get();
-    rule->nonterm->follows.insert(endmark);
-
-    bool found = false;
-    do {
-        found = false;
-        for (auto& nonterm : nonterms) {
-            nonterm.second->solve_follows(&found);
+    
+    Digraph graph(nonterms.size());
+    graph.sets[all.front()->id].insert(endmark->id);
+    
+    for (auto rule : all_rules) {
+        for (size_t i = 0; i < rule->product.size(); i++) {
+            Nonterm* nonterm = Nonterm::cast(rule->product[i]);
+            if (!nonterm) {
+                continue;
+            }
+            
+            bool empty = true;
+            for (size_t j = i + 1; j < rule->product.size() && empty; j++) {
+                Symbol* sym = rule->product[j];
+                Nonterm* next = Nonterm::cast(sym);
+                if (next) {
+                    graph.sets[nonterm->id].insert(next->firsts);
+                    empty = next->empty_first;
+                } else {
+                    graph.sets[nonterm->id].insert(sym->id);
+                    empty = false;
+                }
+            }
+            if (empty) {
+                graph.relate(nonterm->id, rule->nonterm->id);
+            }
         }
-    } while (found);
+    }
+    graph.solve();
+    
+    for (auto& nonterm : nonterms) {
+        nonterm.second->follows = graph.sets[nonterm.second->id];
+    }
+    follow_components = graph.components;
 }
-
@@ -8,9 +8,13 @@
 
 #include "lexer.hpp"
 #include "state.hpp"
+#include "digraph.hpp"
+#include "stats.hpp"
 
 #include <string>
 #include <map>
+#include <set>
+#include <unordered_set>
 #include <memory>
 #include <sstream>
 
@@ -30,8 +34,45 @@ class Grammar
     /** Reads in the user defined grammar. */
     bool read_grammar(std::istream& in);
     
-    /** After reading, solve for all of the possible parse states. */
+    /**
+     * After reading, solve for the lexer and for all of the possible parse
+     * states.  Each can be solved on its own, so that only the parts of a
+     * changed grammar that were not loaded from a cache are solved again.
+     */
+    void solve_lexer();
     void solve_states();
+    
+    /**
+     * Canonical LR(1) parse tables keep every unique set of items as a
+     * separate state.  LALR(1) tables merge the states that share the same
+     * core, which greatly reduces the number of states but can introduce
+     * reduce/reduce conflicts.  Minimal LR(1) tables only merge states with
+     * the same core when the merge cannot introduce a new conflict.
+     */
+    enum Method { CANONICAL, LALR, MINIMAL };
+    Method method;
+    
+    /** Number of threads used to solve for the parse states. */
+    size_t threads;
+    
+    /**
+     * Unit rules have a single symbol and no action, so the value of the
+     * symbol is passed through as the value of the nonterminal.  When set,
+     * the parse table skips over the states that only reduce a unit rule.
+     */
+    bool skip_units;
+    static bool is_unit(const Nonterm::Rule* rule);
+    
+    /**
+     * Number of conflicts not resolved by precedence and the text reporting
+     * each conflict found while solving the states.  Both are saved with the
+     * states, so that states loaded from a cache report the same conflicts.
+     */
+    size_t conflicts;
+    std::string conflict_report;
+    
+    /** Time, memory and sizes of each phase of solving. */
+    Stats stats;
             
     /** Unique terminals and nonterminals of the grammar. */
     std::map<std::string, std::unique_ptr<Term>> terms;
@@ -40,6 +81,9 @@ class Grammar
     std::vector<Nonterm::Rule*> all_rules;
     Endmark endmark;
     
+    /** Terminals and the endmark indexed by their ids. */
+    std::vector<Symbol*> all_terms;
+    
     /**
      * While reading rules the grammar will also build a lexer for finding
      * terminals in an input string.  Each accept state corresponds to a
@@ -47,26 +91,56 @@ class Grammar
      */
     Lexer lexer;
 
-    /** Unique parse states of the grammar. */
-    struct is_same {
-        bool operator() (const std::unique_ptr<State>& lhs,
-                         const std::unique_ptr<State>& rhs) const {
-            return *lhs < *rhs;
-        }
-    };
-    std::set<std::unique_ptr<State>, is_same> states;
+    /** Unique parse states of the grammar indexed by their ids. */
+    Arena<State> state_arena;
+    std::vector<State*> states;
     State* start;
     
+    /** Items added by the closure of each nonterminal and lookaheads. */
+    State::Closures closures;
+    
+    /** Components of the graphs solved for the firsts and follows. */
+    std::vector<Digraph::Component> first_components;
+    std::vector<Digraph::Component> follow_components;
+    
     std::vector<std::string> includes;
     
     void print_grammar(std::ostream& out) const;
     void print_states(std::ostream& out) const;
+    void print_summary(std::ostream& out) const;
     
   private:
+    /**
+     * Interns the parse states by the hash of their kernel items.  States are
+     * only compared when their hashes match.
+     */
+    struct is_same {
+        bool operator() (const State* lhs, const State* rhs) const {
+            return lhs->same_kernel(*rhs);
+        }
+    };
+    struct by_hash {
+        size_t operator() (const State* state) const {
+            return state->hash;
+        }
+    };
+    std::unordered_set<State*, by_hash, is_same> interned;
+    
+    /** Rules of every nonterminal, laid out in the order they are read. */
+    Arena<Nonterm::Rule> rule_arena;
+    
+    /** Number of precedence declarations read so far. */
+    size_t precedences;
+    
+    /** Terminals that have a regex or literal pattern in the lexer. */
+    std::set<Term*> patterned;
+    
     /** Recursive decent parser for reading grammar rules. */
     bool read_term(std::istream& in);
     bool read_rules(std::istream& in);
-    bool read_product(std::istream& in, std::vector<Symbol*>* syms);
+    bool read_product(std::istream& in, std::vector<Symbol*>* syms,
+                      Term** prec);
+    bool read_precedence(std::istream& in);
     bool read_comment(std::istream& in);
             
     bool read_term_name(std::istream& in, std::string* name);
@@ -79,17 +153,52 @@ class Grammar
     
     bool read_include(std::istream& in);
     
-    /** Interns symbol names while reading production rules. */
-    Term* intern_term(std::istream& in);
+    /**
+     * Interns symbol names while reading production rules.  A terminal named
+     * in a rule is matched as a literal unless it already has a pattern, but
+     * one named only by %prec or a precedence declaration is not matched.
+     */
+    Term* intern_term(std::istream& in, bool literal);
     Nonterm* intern_nonterm(std::istream& in);
 
     /**
      * The first step to finding all possible parse states is finding all
      * terminals that could be first in a rule or any terminal which could
-     * follow a nonterminal.
+     * follow a nonterminal.  Both are solved over a graph of the relations
+     * between nonterminals, after finding the nonterminals that can be empty.
      */
+    void solve_empty();
     void solve_first();
     void solve_follows(Symbol* endmark);
+    
+    /** Finds all of the states reachable from the start state. */
+    void solve_serial(State state);
+    void solve_parallel(State state);
+    void number_states();
+    
+    /** Adds newly found states to the list of states to check. */
+    State* intern(State state, std::vector<State*>* checking);
+    
+    /**
+     * Merges states with the same core for LALR(1) parse tables.  For minimal
+     * LR(1) tables the groups of states are first divided until no group has
+     * a new conflict and all states of a group move to the same groups.
+     */
+    typedef std::vector<std::vector<State*>> Groups;
+    void merge_states();
+    void divide_conflicts(Groups* groups);
+    void divide_nexts(Groups* groups);
+    static bool compatible(const State::Reduces& group,
+                           const State::Reduces& state);
+    
+    /**
+     * Shifts and gotos that lead to a state that only reduces a unit rule
+     * instead lead to the state after the unit rule's nonterminal.  States
+     * no longer reached from the start state are then removed.
+     */
+    void skip_unit_rules();
+    State* skip_chain(State* from, State* next) const;
+    void remove_unreached();
 };
 
 #endif
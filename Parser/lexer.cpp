@@ -1,5 +1,8 @@
 #include "lexer.hpp"
 
+#include <algorithm>
+#include <climits>
+#include <iterator>
 #include <sstream>
 using std::cerr;
 
@@ -22,6 +25,7 @@ Lexer::add_regex(Term* accept, const std::string& regex)
     }
     
     exprs.push_back(std::move(expr));
+    patterns.push_back({accept, regex, true});
     return true;
 }
 
@@ -35,6 +39,7 @@ Lexer::add_literal(Term* accept, const std::string& series)
     }
     
     literals.push_back(std::move(expr));
+    patterns.push_back({accept, series, false});
     return true;
 }
 
@@ -47,23 +52,28 @@ Lexer::add_literal(Term* accept, const std::string& series)
  * character ranges to new sets of states.  Each new found set of states will
  * define a new DFA state.  This searching will continue until no new sets of
  * states are found.
+ *
+ * Only the first character of each character class is followed, since every
+ * other character of the class leads to the same set of states.
  */
 void
 Lexer::solve()
 {
+    solve_classes();
+
     /** Build the first state from the start state of all expressions. */
-    std::unique_ptr<Node> first = std::make_unique<Node>(nodes.size());
+    initial = node_arena.make(nodes.size());
     for (auto& expr : exprs) {
-        first->add_finite(expr->start);
+        initial->add_finite(expr->start);
     }
     for (auto& expr : literals) {
-        first->add_finite(expr->start);
+        initial->add_finite(expr->start);
     }
     
-    first->solve_closure();
-    first->solve_accept();
-    initial = first.get();
-    nodes.insert(std::move(first));
+    initial->solve_closure();
+    initial->solve_accept();
+    interned.insert(initial);
+    nodes.push_back(initial);
     
     std::vector<Node*> pending;
     pending.push_back(initial);
@@ -73,186 +83,322 @@ Lexer::solve()
         Node* current = pending.back();
         pending.pop_back();
         
-        /** Check every character for a possible new set. */
-        int c = 0;
-        while (c <= CHAR_MAX) {
-            std::set<Finite*> found;
-            current->move(c, &found);
-            
-            int first = c;
-            int last = c++;
-            bool matches = true;
+        /** Check every class for a possible new set. */
+        std::set<Finite*> found;
+        current->move(classes.front().first, &found);
+        current->moves.assign(classes.size(), nullptr);
+        
+        size_t i = 0;
+        while (i < classes.size()) {
+            size_t first = i++;
             
-            /** Keep looking to check if the next char is the same set. */
-            while (c <= CHAR_MAX && matches) {
-                std::set<Finite*> next;
-                current->move(c, &next);
-                matches = found == next;
-                if (matches) {
-                    last = c++;
+            /** Keep looking to check if the next class is the same set. */
+            std::set<Finite*> next;
+            while (i < classes.size()) {
+                current->move(classes[i].first, &next);
+                if (next != found) {
+                    break;
                 }
+                i++;
+                next.clear();
             }
             
-            /** After searching check to see if the state was already found. */
             if (found.size() > 0) {
-                auto state = std::make_unique<Node>(nodes.size());
-                state->add_finite(found);
-                state->solve_closure();
-                
-                auto inserted = nodes.insert(std::move(state));
-                Node* next = inserted.first->get();
-                current->add_next(first, last, next);
-                
-                /** Check newly found state for other possible DFA states. */
-                if (inserted.second) {
-                    next->solve_accept();
-                    pending.push_back(next);
+                Node* target = solve_next(found, &pending);
+                for (size_t c = first; c < i; c++) {
+                    current->add_move(c, target);
                 }
             }
+            found.swap(next);
         }
     }
+    
+    for (Node* node : nodes) {
+        node->solve_nexts(classes);
+    }
 }
 
+/** Nodes loaded by their ranges of characters find their moves by class. */
 void
-Lexer::reduce()
+Lexer::solve_moves()
 {
-    std::set<Group> current = partition();
-    std::set<Group> found = current;
+    solve_classes();
+    for (Node* node : nodes) {
+        node->solve_moves(classes);
+    }
+}
 
-    while (true) {
-        for (auto group : current) {
-            std::vector<Group> divided = group.divide(current);
-            found.erase(group);
-            copy(divided.begin(), divided.end(), inserter(found, found.end()));
+/**
+ * Every byte where the range of an output starts, or the byte after one ends,
+ * starts a new class.  The classes cover every byte from 0 to 255, so that
+ * input that is not ASCII, such as the bytes of UTF-8, can be matched.
+ */
+void
+Lexer::solve_classes()
+{
+    std::set<int> starts;
+    starts.insert(0);
+    for (auto& expr : exprs) {
+        expr->bounds(&starts);
+    }
+    for (auto& expr : literals) {
+        expr->bounds(&starts);
+    }
+    
+    classes.clear();
+    for (auto itr = starts.begin(); itr != starts.end(); itr++) {
+        int first = *itr;
+        if (first > UCHAR_MAX) {
+            continue;
         }
-        if (current == found) {
-            break;
-        } else {
-            current = found;
+        auto after = std::next(itr);
+        int last = UCHAR_MAX;
+        if (after != starts.end() && *after <= UCHAR_MAX) {
+            last = *after - 1;
         }
+        classes.push_back(Node::Range(first, last));
+    }
+}
+
+/** Returns the node for the closure of the found states, adding it if new. */
+Node*
+Lexer::solve_next(std::set<Finite*>& found, std::vector<Node*>* pending)
+{
+    Node state(nodes.size());
+    state.add_finite(found);
+    state.solve_closure();
+    
+    auto existing = interned.find(&state);
+    if (existing != interned.end()) {
+        return *existing;
+    }
+    
+    /** Check the new state for other possible DFA states. */
+    Node* next = node_arena.make(std::move(state));
+    interned.insert(next);
+    nodes.push_back(next);
+    next->solve_accept();
+    pending->push_back(next);
+    return next;
+}
+
+/**
+ * Merges nodes that accept the same pattern and, on every character class,
+ * move to nodes that are themselves merged.  The nodes start in one block for
+ * each accepted pattern, and blocks are split until no class tells members of
+ * a block apart.  Moving to no node at all is a move to a dead node, which is
+ * kept in a block by itself.  The node first found in each block represents
+ * the block, so the initial node is kept.
+ */
+void
+Lexer::reduce()
+{
+    size_t dead = nodes.size();
+    std::vector<size_t> groups(dead + 1);
+    std::map<Term*, size_t> accepts;
+    for (size_t i = 0; i < dead; i++) {
+        auto found = accepts.insert({nodes[i]->accept, accepts.size()});
+        groups[i] = found.first->second;
     }
+    groups[dead] = accepts.size();
+    
+    Partition partition(groups);
+    partition.refine(solve_table(), classes.size());
 
-    std::map<Node*, Node*> replacement;
-    for (auto group : current) {
-        Node* prime = group.represent(replacement, initial);
+    std::vector<Node*> replacement(dead);
+    primes.clear();
+    for (auto& block : partition.blocks) {
+        size_t lowest = *std::min_element(block.begin(), block.end());
+        if (lowest == dead) {
+            continue;
+        }
+        Node* prime = nodes[lowest];
+        for (size_t member : block) {
+            replacement[member] = prime;
+        }
         primes.insert(prime);
     }
     for (Node* prime : primes) {
         prime->replace(replacement);
-        prime->reduce();
+        prime->solve_nexts(classes);
+    }
+    
+    /** Keeps only the prime nodes, numbered in the order they were found. */
+    struct {
+        bool operator()(Node* a, Node* b) const { return a->id < b->id; }
+    } compare;
+    
+    nodes.assign(primes.begin(), primes.end());
+    std::sort(nodes.begin(), nodes.end(), compare);
+    for (size_t i = 0; i < nodes.size(); i++) {
+        nodes[i]->id = i;
     }
 }
 
-std::set<Lexer::Group>
-Lexer::partition()
+size_t
+Lexer::count_finites() const
 {
-    //std::map<Term*, Group> split;
-    std::map<Term*, Group> split;
-    for (auto& state : nodes) {
-        split[state->accept].insert(state.get());
+    size_t result = 0;
+    for (auto& expr : exprs) {
+        result += expr->size();
     }
-
-    std::set<Group> result;
-    for (auto group : split) {
-        result.insert(group.second);
+    for (auto& expr : literals) {
+        result += expr->size();
     }
     return result;
 }
 
-/******************************************************************************/
-void
-Lexer::Group::insert(Node* state) {
-    nodes.insert(state);
-}
-
-bool
-Lexer::Group::belongs(Node* state, const std::set<Group>& all) const
+std::vector<size_t>
+Lexer::solve_table() const
 {
-    if (nodes.size() < 1) {
-        return false;
-    }
-
-    Node* check = *nodes.begin();
-    for (int c = 0; c <= CHAR_MAX; c++) {
-        Node* check_next = check->get_next(c);
-        Node* state_next = state->get_next(c);
-        if (check_next || state_next) {
-            if (!check_next || !state_next) {
-                return false;
-            } else if (!same_group(check_next, state_next, all)) {
-                return false;
+    size_t dead = nodes.size();
+    size_t width = classes.size();
+    std::vector<size_t> table((dead + 1) * width, dead);
+    
+    for (size_t i = 0; i < dead; i++) {
+        for (size_t c = 0; c < width; c++) {
+            Node* next = nodes[i]->get_next(c);
+            if (next) {
+                table[i * width + c] = next->id;
             }
         }
     }
-    return true;
+    return table;
 }
 
-bool
-Lexer::Group::same_group(Node* s1, Node* s2, const std::set<Group>& all)
+/******************************************************************************/
+Lexer::Partition::Partition(const std::vector<size_t>& initial):
+    block(initial),
+    position(initial.size())
 {
-    for (auto check : all) {
-        if (check.nodes.count(s1) > 0) {
-            if (check.nodes.count(s2) > 0) {
-                return true;
-            } else {
-                return false;
-            }
+    for (size_t i = 0; i < initial.size(); i++) {
+        if (initial[i] >= blocks.size()) {
+            blocks.resize(initial[i] + 1);
         }
+        position[i] = blocks[initial[i]].size();
+        blocks[initial[i]].push_back(i);
     }
-    return false;
+    marked.resize(blocks.size(), 0);
 }
 
-std::vector<Lexer::Group>
-Lexer::Group::divide(const std::set<Group>& PI) const
+/**
+ * Each block and class waiting in the list splits every block into the nodes
+ * that move into the block on the class and the nodes that do not.  When a
+ * block is split, only the smaller half needs to wait to split other blocks,
+ * unless the block was already waiting, which keeps the number of times each
+ * node is used to split to the log of the number of nodes.
+ */
+void
+Lexer::Partition::refine(const std::vector<size_t>& table, size_t width)
 {
-    std::vector<Group> result;
-
-    for (auto state : nodes) {
-        bool found = false;
-        for (auto& group : result) {
-            if (group.belongs(state, PI)) {
-                group.nodes.insert(state);
-                found = true;
-                break;
+    size_t size = block.size();
+    
+    /** Sources of the moves into each node on each class. */
+    std::vector<size_t> begin(width * size + 1, 0);
+    for (size_t i = 0; i < size; i++) {
+        for (size_t c = 0; c < width; c++) {
+            begin[c * size + table[i * width + c] + 1]++;
+        }
+    }
+    for (size_t i = 1; i < begin.size(); i++) {
+        begin[i] += begin[i - 1];
+    }
+    std::vector<size_t> sources(width * size);
+    std::vector<size_t> fill(begin.begin(), begin.end() - 1);
+    for (size_t i = 0; i < size; i++) {
+        for (size_t c = 0; c < width; c++) {
+            sources[fill[c * size + table[i * width + c]]++] = i;
+        }
+    }
+    
+    std::vector<std::pair<size_t, size_t>> pending;
+    std::vector<std::vector<bool>> waiting;
+    for (size_t b = 0; b < blocks.size(); b++) {
+        waiting.push_back(std::vector<bool>(width, true));
+        for (size_t c = 0; c < width; c++) {
+            pending.push_back({b, c});
+        }
+    }
+    
+    std::vector<std::pair<size_t, size_t>> splits;
+    while (pending.size() > 0) {
+        size_t splitter = pending.back().first;
+        size_t c = pending.back().second;
+        pending.pop_back();
+        waiting[splitter][c] = false;
+        
+        std::vector<size_t> targets = blocks[splitter];
+        for (size_t target : targets) {
+            size_t from = begin[c * size + target];
+            size_t to = begin[c * size + target + 1];
+            for (size_t k = from; k < to; k++) {
+                mark(sources[k]);
             }
         }
-        if (!found) {
-            Group added;
-            added.nodes.insert(state);
-            result.push_back(added);
+        
+        splits.clear();
+        split(&splits);
+        for (auto& halves : splits) {
+            size_t kept = halves.first;
+            size_t added = halves.second;
+            waiting.push_back(std::vector<bool>(width, false));
+            for (size_t d = 0; d < width; d++) {
+                size_t next = added;
+                if (!waiting[kept][d]
+                        && blocks[kept].size() < blocks[added].size()) {
+                    next = kept;
+                }
+                waiting[next][d] = true;
+                pending.push_back({next, d});
+            }
         }
     }
-    return result;
 }
 
-Node*
-Lexer::Group::represent(std::map<Node*, Node*>& replace, Node* start)
+/** Moves the element to the end of its block, before the other marked. */
+void
+Lexer::Partition::mark(size_t element)
 {
-    Node* result = nullptr;
-    for (auto s : nodes) {
-        if (s == start) {
-            result = s;
-            break;
-        }
+    size_t owner = block[element];
+    std::vector<size_t>& members = blocks[owner];
+    size_t last = members.size() - 1 - marked[owner];
+    if (position[element] > last) {
+        return;
     }
-    if (!result) {
-        auto lowest = min_element(nodes.begin(), nodes.end(), Node::lower);
-        result = *lowest;
-    }
-
-    for (Node* state : nodes) {
-        replace[state] = result;
+    
+    size_t other = members[last];
+    std::swap(members[position[element]], members[last]);
+    position[other] = position[element];
+    position[element] = last;
+    
+    if (marked[owner]++ == 0) {
+        touched.push_back(owner);
     }
-    return result;
 }
 
-bool
-Lexer::Group::operator<(const Group& other) const {
-    return nodes < other.nodes;
-}
-
-bool
-Lexer::Group::operator==(const Group& other) const {
-    return nodes == other.nodes;
+/** Marked members of a partly marked block become a new block. */
+void
+Lexer::Partition::split(std::vector<std::pair<size_t, size_t>>* splits)
+{
+    for (size_t owner : touched) {
+        size_t count = marked[owner];
+        marked[owner] = 0;
+        
+        std::vector<size_t>& members = blocks[owner];
+        if (count == members.size()) {
+            continue;
+        }
+        
+        size_t added = blocks.size();
+        std::vector<size_t> moved(members.end() - count, members.end());
+        members.resize(members.size() - count);
+        for (size_t i = 0; i < moved.size(); i++) {
+            block[moved[i]] = added;
+            position[moved[i]] = i;
+        }
+        blocks.push_back(std::move(moved));
+        marked.push_back(0);
+        splits->push_back({owner, added});
+    }
+    touched.clear();
 }
-
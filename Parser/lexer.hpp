@@ -49,39 +49,72 @@ class Lexer
     /** After building the DFA, call reduce to minimize the states. */
     void reduce();
     
+    /** After loading nodes with only their ranges, call to find the moves. */
+    void solve_moves();
+    
+    /** Returns the number of states in the NFA of every pattern. */
+    size_t count_finites() const;
+    
   private:
     std::vector<std::unique_ptr<Regex>> exprs;
     std::vector<std::unique_ptr<Literal>> literals;
 
-  public:    
+  public:
+    /** Source of each added pattern, in the order the patterns were added. */
+    struct Pattern {
+        Term* accept;
+        std::string text;
+        bool regex;
+    };
+    std::vector<Pattern> patterns;
+    
     /** The DFA is defined by an initial state and unique sets of NFA states. */
-    std::set<std::unique_ptr<Node>, Node::is_same> nodes;
+    Arena<Node> node_arena;
+    std::vector<Node*> nodes;
     std::set<Node*> primes;
     Node* initial;
+    
+    /**
+     * Disjoint ranges covering every byte, split wherever a range of any
+     * output in the NFA starts or ends.  Every character in a class moves any
+     * set of NFA states to the same next set.
+     */
+    std::vector<Node::Range> classes;
  
   private:
-    /** Groups of states for minimizing the number of DFA states. */
-    class Group {
+    /** Nodes found while solving, interned by their sets of NFA states. */
+    std::set<Node*, Node::is_same> interned;
+    
+    void solve_classes();
+    Node* solve_next(std::set<Finite*>& found, std::vector<Node*>* pending);
+    
+    /** Next node of each node on each class, with a dead node at the end. */
+    std::vector<size_t> solve_table() const;
+    
+    /**
+     * Partition of the nodes into blocks of nodes that might be equivalent,
+     * refined by the algorithm of Hopcroft until every block holds only nodes
+     * that accept the same pattern and move to the same blocks on every class.
+     * The members of each block are kept in an array with the marked members
+     * at the end, so splitting a block takes time in the number of marked.
+     */
+    class Partition {
       public:
-        void insert(Node* state);
-
-        bool belongs(Node* state, const std::set<Group>& all) const;
-        std::vector<Group> divide(const std::set<Group>& PI) const;
+        Partition(const std::vector<size_t>& initial);
+        std::vector<std::vector<size_t>> blocks;
         
-        /** Find a state that represents all states in the group. */
-        Node* represent(std::map<Node*, Node*>& replace, Node* start);
-
-        bool operator<(const Group& other) const;
-        bool operator==(const Group& other) const;
+        /** Splits blocks until the table cannot tell members apart. */
+        void refine(const std::vector<size_t>& table, size_t width);
 
       private:
-        std::set<Node*> nodes;
-        static bool same_group(Node* s1, Node* s2, const std::set<Group>& all);
+        std::vector<size_t> block;
+        std::vector<size_t> position;
+        std::vector<size_t> marked;
+        std::vector<size_t> touched;
+        
+        void mark(size_t element);
+        void split(std::vector<std::pair<size_t, size_t>>* splits);
     };
-    
-
-    /** Initial partion of the states. */
-    std::set<Group> partition();
 };
 
 #endif
@@ -6,6 +6,16 @@
 Literal::Literal():
     start(nullptr) {}
 
+size_t
+Literal::size() const {
+    return states.size();
+}
+
+void
+Literal::bounds(std::set<int>* starts) const {
+    outs.each([starts](const Finite::Out& out) { out.bounds(starts); });
+}
+
 std::unique_ptr<Literal>
 Literal::build(const std::string& series, Term* accept)
 {
@@ -25,19 +35,17 @@ Literal::build(const std::string& series, Term* accept)
 
 /**
  * Builds a new state and retains ownership.  No memory leaks occur if any
- * exceptions or errors occur during subset construction, as the states vector
- * contains all fragments of the automaton.
+ * exceptions or errors occur during subset construction, as the arenas of
+ * states and outputs contain all fragments of the automaton.
  */
 Finite*
 Literal::add_state() {
-    states.emplace_back(std::make_unique<Finite>());
-    return states.back().get();
+    return states.make(&outs);
 }
 
 Finite*
 Literal::add_state(Term* accept) {
-    states.emplace_back(std::make_unique<Finite>(accept));
-    return states.back().get();
+    return states.make(&outs, accept);
 }
 
 /**
@@ -54,7 +62,7 @@ Literal::parse_term(std::istream& series, Term* accept)
     while (true)
     {
         int c = series.get();
-        if (!isprint(c)) {
+        if (c == EOF || (c < 0x80 && !isprint(c))) {
             std::cerr << "Expected a printable character.\n";
             return nullptr;
         }
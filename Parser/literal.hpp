@@ -20,12 +20,17 @@ class Literal
     build(const std::string& pattern, Term* accept);
     
     Literal();
+    size_t size() const;
+
+    /** Adds the characters that start a range in any output of the NFA. */
+    void bounds(std::set<int>* starts) const;
 
     /** After building, call start's scan method to check for a match. */
     Finite* start;
 
   private:
-    std::vector<std::unique_ptr<Finite>> states;
+    Arena<Finite> states;
+    Arena<Finite::Out> outs;
     Finite* add_state();
     Finite* add_state(Term* accept);
 
@@ -3,24 +3,73 @@
  * the standard input, then solves for all of the parse states.  After solving
  * for the parse states, writes the source code for the parse table to the
  * standard output.
+ *
+ * Options:
+ *   --lalr        Merge states with the same core into LALR(1) parse tables.
+ *   --minimal     Merge states only when the merge cannot add a conflict.
+ *   --threads     Number of threads used to solve for the parse states.
+ *   --skip-units  Skip over the reductions of unit rules without actions.
+ *   --verbose     Print a summary of the solved states and packed tables.
+ *   --cache       File of solved tables, reusing the parts that are unchanged.
+ *   --stats       Print the time, memory and sizes of each phase.
+ *   --stats-json  File to write the same report as JSON.
  */
 
 #include "grammar.hpp"
 #include "display.hpp"
 #include "code.hpp"
+#include "cache.hpp"
 
 #include <iostream>
 #include <fstream>
+#include <sstream>
 
 /******************************************************************************/
 int
 main(int argc, const char * argv[])
 {
     Grammar grammar;
+    const char* path = nullptr;
+    const char* cache = nullptr;
+    const char* json = nullptr;
+    bool verbose = false;
+    bool stats = false;
     
-    if (argc > 1) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--lalr") {
+            grammar.method = Grammar::LALR;
+        } else if (arg == "--minimal") {
+            grammar.method = Grammar::MINIMAL;
+        } else if (arg == "--threads" && i + 1 < argc) {
+            int count = atoi(argv[++i]);
+            if (count < 1) {
+                std::cerr << "Expected a positive number of threads.\n";
+                return 1;
+            }
+            grammar.threads = count;
+        } else if (arg == "--skip-units") {
+            grammar.skip_units = true;
+        } else if (arg == "--verbose") {
+            verbose = true;
+        } else if (arg == "--cache" && i + 1 < argc) {
+            cache = argv[++i];
+        } else if (arg == "--stats") {
+            stats = true;
+        } else if (arg == "--stats-json" && i + 1 < argc) {
+            json = argv[++i];
+        } else if (arg.size() > 1 && arg[0] == '-') {
+            std::cerr << "Unknown option '" << arg << "'.\n";
+            return 1;
+        } else {
+            path = argv[i];
+        }
+    }
+    
+    grammar.stats.start("read_grammar");
+    if (path) {
         std::fstream in;
-        in.open(argv[1]);
+        in.open(path);
         if (!in) {
             std::cerr << "Unable to read input file.\n";
             return 1;
@@ -52,8 +101,63 @@ main(int argc, const char * argv[])
         }
     }    
 
-    grammar.solve_states();
-    Code::write(grammar, std::cout);
+    grammar.stats.count("terms", grammar.all_terms.size());
+    grammar.stats.count("nonterms", grammar.nonterms.size());
+    grammar.stats.count("rules", grammar.all_rules.size());
+
+    bool cached_lexer = false;
+    bool cached_states = false;
+    if (cache) {
+        grammar.stats.start("cache_load");
+        std::ifstream in(cache, std::ios::binary);
+        if (in) {
+            Cache::load(&grammar, in, &cached_lexer, &cached_states);
+        }
+    }
+    if (!cached_lexer) {
+        grammar.solve_lexer();
+    }
+    if (!cached_states) {
+        grammar.solve_states();
+    } else {
+        std::cerr << grammar.conflict_report;
+        grammar.stats.count("conflicts", grammar.conflicts);
+    }
+    if (cache && !(cached_lexer && cached_states)) {
+        grammar.stats.start("cache_save");
+        std::ofstream out(cache, std::ios::binary);
+        Cache::save(grammar, out);
+        if (!out) {
+            std::cerr << "Unable to write cache file.\n";
+        }
+    }
+    
+    if (verbose) {
+        if (cache) {
+            std::cerr << "Cache: lexer ";
+            std::cerr << (cached_lexer ? "loaded" : "solved") << ", states ";
+            std::cerr << (cached_states ? "loaded" : "solved") << "\n";
+        }
+        grammar.print_summary(std::cerr);
+    }
+    
+    grammar.stats.start("write_code");
+    std::ostringstream code;
+    Code::write(grammar, code, verbose ? &std::cerr : nullptr, &grammar.stats);
+    grammar.stats.count("code_bytes", code.str().size());
+    std::cout << code.str();
+    grammar.stats.stop();
+    
+    if (stats) {
+        grammar.stats.print(std::cerr);
+    }
+    if (json) {
+        std::ofstream out(json);
+        grammar.stats.print_json(out);
+        if (!out) {
+            std::cerr << "Unable to write stats file.\n";
+        }
+    }
 
     return 0;
 }
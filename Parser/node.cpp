@@ -1,5 +1,7 @@
 #include "node.hpp"
 
+#include <algorithm>
+
 /******************************************************************************/
 Node::Node(size_t id):
     id(id),
@@ -16,23 +18,26 @@ Node::add_finite(std::set<Finite*>& finites) {
 }
 
 void
-Node::add_next(int first, int last, Node* next) {
-    nexts[Range(first, last)] = next;
+Node::add_move(size_t index, Node* next)
+{
+    if (index >= moves.size()) {
+        moves.resize(index + 1, nullptr);
+    }
+    moves[index] = next;
 }
 
 Node*
-Node::get_next(int c)
-{
-    for (auto next : nexts) {
-        if (c >= next.first.first && c <= next.first.last) {
-            return next.second;
-        }
-    }
-    return nullptr;
+Node::get_next(size_t index) const {
+    return index < moves.size() ? moves[index] : nullptr;
 }
 
 void
-Node::move(char c, std::set<Finite*>* found) {
+Node::add_next(int first, int last, Node* next) {
+    nexts.push_back({Range(first, last), next});
+}
+
+void
+Node::move(int c, std::set<Finite*>* found) {
     for (Finite* item : items) {
         item->move(c, found);
     }
@@ -70,38 +75,51 @@ Node::solve_accept()
 }
 
 void
-Node::replace(std::map<Node*, Node*> prime)
+Node::replace(const std::vector<Node*>& prime)
 {
-    for (auto& next : nexts) {
-        if (prime.count(next.second) > 0) {
-            next.second = prime[next.second];
+    for (auto& move : moves) {
+        if (move) {
+            move = prime[move->id];
+        }
+    }
+}
+
+/**
+ * The classes are in order and cover every character, so neighboring classes
+ * that move to the same node are joined into a single range.
+ */
+void
+Node::solve_nexts(const std::vector<Range>& classes)
+{
+    nexts.clear();
+    size_t i = 0;
+    while (i < classes.size()) {
+        Node* next = get_next(i);
+        int first = classes[i].first;
+        int last = classes[i++].last;
+        while (i < classes.size() && get_next(i) == next) {
+            last = classes[i++].last;
+        }
+        if (next) {
+            add_next(first, last, next);
         }
     }
 }
 
+/** Each range covers whole classes, since it was joined from them. */
 void
-Node::reduce()
+Node::solve_moves(const std::vector<Range>& classes)
 {
-    std::map<Node::Range, Node*> updated;
-
-    auto itr = nexts.begin();
-    while (itr != nexts.end()) {
-        int first = itr->first.first;
-        int last  = itr->first.last;
-        Node* next = itr->second;
-        itr++;
-
-        bool matches = true;
-        while (itr != nexts.end() && matches) {
-            matches = itr->second == next && (last + 1) == itr->first.first;
-            if (matches) {
-                last = itr->first.last;
-                itr++;
-            }
+    moves.assign(classes.size(), nullptr);
+    size_t c = 0;
+    for (auto& next : nexts) {
+        while (c < classes.size() && classes[c].first < next.first.first) {
+            c++;
+        }
+        while (c < classes.size() && classes[c].first <= next.first.last) {
+            moves[c++] = next.second;
         }
-        updated[Node::Range(first, last)] = next;
     }
-    nexts = updated;
 }
 
 bool
@@ -120,23 +138,19 @@ Node::lower(Node* left, Node* right)
 Node::Range::Range(int first, int last):
     first(first), last(last) {}
 
-bool
-Node::Range::operator<(const Range& other) const {
-    return last < other.first;
-}
-
 void
 Node::Range::write(std::ostream& out) const
 {
     if (first == last) {
-        if (isprint(first) && first != '\'') {
+        if (isprint(first) && first != '\'' && first != '\\') {
             out << "c == '" << (char)first << "'";
         } else {
             out << "c == " << first << "";
         }
     } else {
         if (isprint(first) && isprint(last)
-                && first != '\'' && last != '\'') {
+                && first != '\'' && last != '\''
+                && first != '\\' && last != '\\') {
             out << "(c >= '" << (char)first << "')";
             out << " && ";
             out << "(c <= '" << (char)last << "')";
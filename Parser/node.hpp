@@ -1,7 +1,8 @@
 /*******************************************************************************
  * State of a deterministic finite automaton (DFA).  The DFA is built by finding
- * the next set of possible NFA states after reading an input character.  Ranges
- * within each node map an input character to a single next node in the DFA.
+ * the next set of possible NFA states after reading an input character.  Each
+ * node moves to a single next node on each class of characters, and the moves
+ * are joined into sorted ranges of characters for writing the source code.
  */
 #ifndef node_hpp
 #define node_hpp
@@ -22,39 +23,49 @@ class Node {
     void add_finite(Finite* finite);
     void add_finite(std::set<Finite*>& finites);
     
+    /** Map a character class to the next DFA node. */
+    void add_move(size_t index, Node* next);
+    Node* get_next(size_t index) const;
+    
     /** Map a range of characters to the next DFA node. */
     void add_next(int first, int last, Node* next);
-    Node* get_next(int c);
 
     /** Solving for the next states in the DFA from this state. */
-    void move(char c, std::set<Finite*>* next);
+    void move(int c, std::set<Finite*>* next);
     void solve_closure();
     void solve_accept();
     
-    void replace(std::map<Node*, Node*> prime);
-    void reduce();
-
-    struct is_same {
-        bool operator() (const std::unique_ptr<Node>& left,
-                         const std::unique_ptr<Node>& right) const {
-            return left->items < right->items;
-        }
-    };
-    
-    static bool lower(Node* left, Node* right);
-    
     /** Character range for connecting states. */
     struct Range {
         Range(int first, int last);
         int first;
         int last;
-        bool operator<(const Range& other) const;
         void write(std::ostream& out) const;
     };
     
+    /** Converting between the moves by class and the ranges of characters. */
+    void solve_nexts(const std::vector<Range>& classes);
+    void solve_moves(const std::vector<Range>& classes);
+    
+    /** Replaces each next node with the prime node at the index of its id. */
+    void replace(const std::vector<Node*>& prime);
+
+    struct is_same {
+        bool operator() (const Node* left, const Node* right) const {
+            return left->items < right->items;
+        }
+    };
+    
+    static bool lower(Node* left, Node* right);
+    
     Term* accept;
     std::set<Finite*> items;
-    std::map<Range, Node*> nexts;
+    
+    /** Next node on each character class, null if there is no move. */
+    std::vector<Node*> moves;
+    
+    /** Ranges of characters in order, each joining classes with one next. */
+    std::vector<std::pair<Range, Node*>> nexts;
 };
 
 #endif
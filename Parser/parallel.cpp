@@ -0,0 +1,135 @@
+#include "parallel.hpp"
+
+#include <thread>
+
+/******************************************************************************/
+Workers::Workers(size_t count):
+    remaining(0)
+{
+    for (size_t i = 0; i < count; i++) {
+        queues.push_back(std::make_unique<Queue>());
+    }
+}
+
+/**
+ * Counts the state as remaining before adding it to a queue, so no worker can
+ * find every queue empty while a state is still being checked.
+ */
+void
+Workers::push(size_t worker, State* state)
+{
+    remaining++;
+    Queue& queue = *queues[worker];
+    std::lock_guard<std::mutex> guard(queue.lock);
+    queue.pending.push_back(state);
+}
+
+void
+Workers::run(const std::function<void(size_t worker, State* state)>& task)
+{
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < queues.size(); i++) {
+        threads.emplace_back(&Workers::work, this, i, std::cref(task));
+    }
+    work(0, task);
+
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
+void
+Workers::work(size_t worker,
+              const std::function<void(size_t worker, State* state)>& task)
+{
+    while (true) {
+        State* state = nullptr;
+        if (pop(worker, &state)) {
+            task(worker, state);
+            remaining--;
+        } else if (remaining == 0) {
+            break;
+        } else {
+            std::this_thread::yield();
+        }
+    }
+}
+
+bool
+Workers::pop(size_t worker, State** state)
+{
+    {
+        Queue& queue = *queues[worker];
+        std::lock_guard<std::mutex> guard(queue.lock);
+        if (queue.pending.size() > 0) {
+            *state = queue.pending.back();
+            queue.pending.pop_back();
+            return true;
+        }
+    }
+
+    for (size_t i = 1; i < queues.size(); i++) {
+        Queue& queue = *queues[(worker + i) % queues.size()];
+        std::lock_guard<std::mutex> guard(queue.lock);
+        if (queue.pending.size() > 0) {
+            *state = queue.pending.front();
+            queue.pending.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+/******************************************************************************/
+Interned::Interned(size_t count)
+{
+    for (size_t i = 0; i < count; i++) {
+        shards.push_back(std::make_unique<Shard>());
+    }
+}
+
+/**
+ * The closure is solved without holding the lock.  Interned states are never
+ * changed, except for their next states, so other threads can safely compare
+ * kernels while a new state is being closed.  If another thread adds the same
+ * state first, the newly closed state is discarded.
+ */
+State*
+Interned::intern(State state, State::Closures* closures, bool* found)
+{
+    state.solve_hash();
+    Shard& shard = *shards[state.hash % shards.size()];
+
+    {
+        std::lock_guard<std::mutex> guard(shard.lock);
+        auto existing = shard.interned.find(&state);
+        if (existing != shard.interned.end()) {
+            *found = false;
+            return *existing;
+        }
+    }
+
+    state.closure(closures);
+
+    std::lock_guard<std::mutex> guard(shard.lock);
+    auto existing = shard.interned.find(&state);
+    if (existing != shard.interned.end()) {
+        *found = false;
+        return *existing;
+    }
+    *found = true;
+    State* added = shard.states.make(std::move(state));
+    shard.interned.insert(added);
+    return added;
+}
+
+void
+Interned::release(Arena<State>* arena, std::vector<State*>* states)
+{
+    for (auto& shard : shards) {
+        states->insert(states->end(), shard->interned.begin(),
+                       shard->interned.end());
+        arena->splice(shard->states);
+        shard->interned.clear();
+    }
+}
@@ -0,0 +1,83 @@
+/*******************************************************************************
+ * Solves for the parse states of a grammar with multiple threads.  Finding the
+ * next states and the closure of each newly found state are independent of the
+ * other pending states, so the pending states are shared between a pool of
+ * worker threads.
+ */
+#ifndef parallel_hpp
+#define parallel_hpp
+
+#include "state.hpp"
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <unordered_set>
+
+/*******************************************************************************
+ * Pool of threads that each keep their own queue of pending states.  A worker
+ * takes the most recently added state from its own queue and, when its queue is
+ * empty, steals the oldest state from another worker.  Tasks can push newly
+ * found states, and the pool runs until every pushed state is done.
+ */
+class Workers
+{
+  public:
+    Workers(size_t count);
+
+    void push(size_t worker, State* state);
+    void run(const std::function<void(size_t worker, State* state)>& task);
+
+  private:
+    struct Queue {
+        std::mutex lock;
+        std::deque<State*> pending;
+    };
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::atomic<size_t> remaining;
+
+    bool pop(size_t worker, State** state);
+    void work(size_t worker,
+              const std::function<void(size_t worker, State* state)>& task);
+};
+
+/*******************************************************************************
+ * Table of unique states that is shared between threads.  The table is split
+ * into shards by the hash of each state's kernel, so threads only wait on each
+ * other when interning states with hashes in the same shard.
+ */
+class Interned
+{
+  public:
+    Interned(size_t count);
+
+    /**
+     * Returns the existing state with the same kernel, or closes and adds the
+     * new state.  Found is set if the state was newly added.
+     */
+    State* intern(State state, State::Closures* closures, bool* found);
+
+    /** Moves all interned states out of the table and into the arena. */
+    void release(Arena<State>* arena, std::vector<State*>* states);
+
+  private:
+    struct is_same {
+        bool operator() (const State* lhs, const State* rhs) const {
+            return lhs->same_kernel(*rhs);
+        }
+    };
+    struct by_hash {
+        size_t operator() (const State* state) const {
+            return state->hash;
+        }
+    };
+    struct Shard {
+        std::mutex lock;
+        std::unordered_set<State*, by_hash, is_same> interned;
+        Arena<State> states;
+    };
+    std::vector<std::unique_ptr<Shard>> shards;
+};
+
+#endif
@@ -6,6 +6,16 @@
 Regex::Regex() :
     start(nullptr) {}
 
+size_t
+Regex::size() const {
+    return states.size();
+}
+
+void
+Regex::bounds(std::set<int>* starts) const {
+    outs.each([starts](const Finite::Out& out) { out.bounds(starts); });
+}
+
 /**
  * Builds the NFA for the given regular expression using subset construction.
  * All unconnected outputs from the final automaton are connect to a provided
@@ -36,19 +46,17 @@ Regex::parse(const std::string& in, Term* accept)
 
 /**
  * Builds a new state and retains ownership.  No memory leaks occur if any
- * exceptions or errors occur during subset construction, as the states vector
- * contains all fragments of the automaton.
+ * exceptions or errors occur during subset construction, as the arenas of
+ * states and outputs contain all fragments of the automaton.
  */
 Finite*
 Regex::add_state() {
-    states.emplace_back(std::make_unique<Finite>());
-    return states.back().get();
+    return states.make(&outs);
 }
 
 Finite*
 Regex::add_state(Term* accept) {
-    states.emplace_back(std::make_unique<Finite>(accept));
-    return states.back().get();
+    return states.make(&outs, accept);
 }
 
 /** Parses the lowest precedence operator, the vertical bar. */
@@ -197,6 +205,14 @@ Regex::parse_atom(std::istream& in, std::vector<Finite::Out*>* outs)
         std::cerr << "Unexpected '" << (char)c << "' in expression.\n";
         return nullptr;
     }
+    else if (c >= 0x80) {
+        int code = 0;
+        if (!Utf8::decode(c, in, &code)) {
+            std::cerr << "Invalid UTF-8 in expression.\n";
+            return nullptr;
+        }
+        return add_codes({{code, code}}, outs);
+    }
     else if (isprint(c)) {
         Finite* state = add_state();
         Finite::Out* out = state->add_out(c, nullptr);
@@ -215,12 +231,12 @@ Regex::parse_atom(std::istream& in, std::vector<Finite::Out*>* outs)
     }
 }
 
-/** Parses a range of characters, [a-z]. */
+/** Parses a range of characters, [a-z] or [\u{3b1}-\u{3c9}]. */
 Finite*
 Regex::parse_atom_range(std::istream& in, std::vector<Finite::Out*>* outs)
 {
-    int first = in.get();
-    if (!isalpha(first) && !isdigit(first)) {
+    int first = 0;
+    if (!parse_code(in, &first)) {
         std::cerr << "Expected a letter or number to start range.\n";
         return nullptr;
     }
@@ -229,8 +245,8 @@ Regex::parse_atom_range(std::istream& in, std::vector<Finite::Out*>* outs)
         return nullptr;
     }
     
-    int last = in.get();
-    if (!isalpha(last) && !isdigit(last)) {
+    int last = 0;
+    if (!parse_code(in, &last)) {
         std::cerr << "Expected a letter or number to end range.\n";
         return nullptr;
     }
@@ -238,27 +254,30 @@ Regex::parse_atom_range(std::istream& in, std::vector<Finite::Out*>* outs)
         std::cerr << "Expected a ']' to end range.\n";
         return nullptr;
     }
+    if (last < first) {
+        std::cerr << "Expected the range to end after it starts.\n";
+        return nullptr;
+    }
     
-    Finite* state = add_state();
-    Finite::Out* out = state->add_out(first, last, nullptr);
-    outs->push_back(out);
-    return state;
+    return add_codes({{first, last}}, outs);
 }
 
-/** Parses not within range of characters, [^a] or [^a-z]. */
+/**
+ * Parses not within range of characters, [^a] or [^a-z].  Any other code point
+ * matches, including those encoded with more than one byte.
+ */
 Finite*
 Regex::parse_atom_not(std::istream& in, std::vector<Finite::Out*>* outs)
 {
-    int first = in.get();
-    if (!isalpha(first) && !isdigit(first)) {
+    int first = 0;
+    if (!parse_code(in, &first)) {
         std::cerr << "Expected a letter or number after not.\n";
         return nullptr;
     }
     int last = first;
     if (in.peek() == '-') {
         in.get();
-        last = in.get();
-        if (!isalpha(last) && !isdigit(last)) {
+        if (!parse_code(in, &last)) {
             std::cerr << "Expected a letter or number to end range.\n";
             return nullptr;
         }
@@ -267,11 +286,19 @@ Regex::parse_atom_not(std::istream& in, std::vector<Finite::Out*>* outs)
         std::cerr << "Expected a ']' to end range.\n";
         return nullptr;
     }
+    if (last < first) {
+        std::cerr << "Expected the range to end after it starts.\n";
+        return nullptr;
+    }
     
-    Finite* state = add_state();
-    Finite::Out* out = state->add_not(first, last, nullptr);
-    outs->push_back(out);
-    return state;
+    Codes codes;
+    if (first > 0) {
+        codes.push_back({0, first - 1});
+    }
+    if (last < Utf8::max_code) {
+        codes.push_back({last + 1, Utf8::max_code});
+    }
+    return add_codes(codes, outs);
 }
 
 // TODO Allow escape sequnces in ranges.
@@ -282,6 +309,14 @@ Regex::parse_atom_escape(std::istream& in, std::vector<Finite::Out*>* outs)
 {
     int c = in.get();
     
+    if (c == 'u') {
+        int code = 0;
+        if (!parse_code_escape(in, &code)) {
+            return nullptr;
+        }
+        return add_codes({{code, code}}, outs);
+    }
+    
     switch (c) {
         case '[': break;
         case ']': break;
@@ -317,3 +352,75 @@ Regex::parse_atom_escape(std::istream& in, std::vector<Finite::Out*>* outs)
     outs->push_back(out);
     return state;
 }
+
+/******************************************************************************/
+bool
+Regex::parse_code(std::istream& in, int* code)
+{
+    int c = in.get();
+    if (isalpha(c) || isdigit(c)) {
+        *code = c;
+        return true;
+    } else if (c == '\\' && in.peek() == 'u') {
+        in.get();
+        return parse_code_escape(in, code);
+    } else if (c >= 0x80) {
+        return Utf8::decode(c, in, code);
+    } else {
+        return false;
+    }
+}
+
+/** Parses the hex digits of a code point in braces, such as \u{1F600}. */
+bool
+Regex::parse_code_escape(std::istream& in, int* code)
+{
+    if (in.get() != '{') {
+        std::cerr << "Expected '{' to start code point.\n";
+        return false;
+    }
+    
+    *code = 0;
+    int digits = 0;
+    while (isxdigit(in.peek()) && digits < 6) {
+        int c = in.get();
+        *code = *code * 16 + (isdigit(c) ? c - '0' : tolower(c) - 'a' + 10);
+        digits++;
+    }
+    if (digits == 0 || in.get() != '}') {
+        std::cerr << "Expected hex digits and '}' to end code point.\n";
+        return false;
+    }
+    if (*code > Utf8::max_code || (*code >= 0xd800 && *code <= 0xdfff)) {
+        std::cerr << "Code point is not a valid character.\n";
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Each sequence of byte ranges becomes a chain of states from a shared first
+ * state.  A code point below 128 is a single byte, so ranges of ASCII need
+ * only one output as before.
+ */
+Finite*
+Regex::add_codes(const Codes& codes, std::vector<Finite::Out*>* outs)
+{
+    std::vector<Utf8::Sequence> sequences;
+    for (auto& code : codes) {
+        Utf8::split(code.first, code.second, &sequences);
+    }
+    
+    Finite* state = add_state();
+    for (auto& sequence : sequences) {
+        Finite* from = state;
+        for (size_t i = 0; i + 1 < sequence.size(); i++) {
+            Finite* next = add_state();
+            from->add_out(sequence[i].first, sequence[i].second, next);
+            from = next;
+        }
+        auto& last = sequence.back();
+        outs->push_back(from->add_out(last.first, last.second, nullptr));
+    }
+    return state;
+}
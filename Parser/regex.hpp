@@ -16,6 +16,8 @@
 #define regex_hpp
 
 #include "finite.hpp"
+#include "utf8.hpp"
+
 #include <iostream>
 
 /******************************************************************************/
@@ -29,9 +31,14 @@ class Regex
     Finite* start;
  
     Regex();
+    size_t size() const;
+
+    /** Adds the characters that start a range in any output of the NFA. */
+    void bounds(std::set<int>* starts) const;
 
   private:
-    std::vector<std::unique_ptr<Finite>> states;
+    Arena<Finite> states;
+    Arena<Finite::Out> outs;
     Finite* add_state();
     Finite* add_state(Term* accept);
     
@@ -53,6 +60,14 @@ class Regex
     Finite* parse_atom_range(std::istream& in, std::vector<Finite::Out*>* outs);
     Finite* parse_atom_not(std::istream& in, std::vector<Finite::Out*>* outs);
     Finite* parse_atom_escape(std::istream& in, std::vector<Finite::Out*>* outs);
+    
+    /** Reads a letter, number, UTF-8 character or \u{...} at a range end. */
+    bool parse_code(std::istream& in, int* code);
+    bool parse_code_escape(std::istream& in, int* code);
+    
+    /** Matches any code point in the ranges by the bytes of its UTF-8. */
+    typedef std::vector<std::pair<int, int>> Codes;
+    Finite* add_codes(const Codes& codes, std::vector<Finite::Out*>* outs);
 };
 
 #endif
@@ -1,79 +1,214 @@
 #include "state.hpp"
 
+#include <algorithm>
+
 using std::vector;
 using std::ostream;
 
 /******************************************************************************/
 State::State(size_t id):
-    id(id){}
+    id(id),
+    hash(0){}
+
+void
+State::solve_hash()
+{
+    hash = 0;
+    for (auto& item : items) {
+        if (item.first.mark > 0) {
+            size_t value = item.first.rule->id * 31 + item.first.mark;
+            value = value * 131 + item.second.hash();
+            hash ^= value + 0x9e3779b97f4a7c15 + (hash << 6) + (hash >> 2);
+        }
+    }
+}
+
+/**
+ * Compares only the kernel items of the states, skipping over any items added
+ * by the closure.
+ */
+bool
+State::same_kernel(const State& other) const
+{
+    auto left = items.begin();
+    auto right = other.items.begin();
+    
+    while (true) {
+        while (left != items.end() && left->first.mark == 0) {
+            left++;
+        }
+        while (right != other.items.end() && right->first.mark == 0) {
+            right++;
+        }
+        if (left == items.end() || right == other.items.end()) {
+            return left == items.end() && right == other.items.end();
+        }
+        if (!(left->first == right->first) || left->second != right->second) {
+            return false;
+        }
+        left++;
+        right++;
+    }
+}
 
 void
-State::add(State::Item item) {
-    items.insert(item);
+State::add(State::Item item, size_t ahead) {
+    items[item].insert(ahead);
 }
 
+/**
+ * The items added by the closure only depend on the nonterminal after the mark
+ * of each kernel item and on the lookaheads for that nonterminal.  The added
+ * items for each pair are found once in the cache of closures and then copied
+ * into every state that needs them.
+ */
 void
-State::closure()
+State::closure(Closures* closures)
 {
-    vector<Item> found;
-    std::copy(items.begin(), items.end(), std::back_inserter(found));
+    vector<std::pair<Item, Bitset>> kernel(items.begin(), items.end());
+    
+    for (auto& item : kernel) {
+        Nonterm* nonterm = item.first.next_nonterm();
+        if (nonterm) {
+            Bitset terms;
+            if (firsts(item.first.rule, item.first.mark + 1, &terms)) {
+                terms.insert(item.second);
+            }
+            for (auto& found : closures->find(nonterm, terms)) {
+                items[found.first].insert(found.second);
+            }
+        }
+    }
+}
 
-    while (found.size() > 0)
+/**
+ * Propagates sets of lookaheads instead of single symbols.  An item is checked
+ * again whenever new lookaheads are added to it, until no set changes.
+ */
+void
+State::expand(Items* items, vector<Item>* found)
+{
+    while (found->size() > 0)
     {
-        Item item = found.back();
-        found.pop_back();
+        Item item = found->back();
+        found->pop_back();
 
         Nonterm* nonterm = item.next_nonterm();
         if (nonterm) {
-            vector<Symbol*> product = item.advance().rest();
-            product.push_back(item.ahead);
-            
-            std::set<Symbol*> terms;
-            firsts(product, &terms);
+            Bitset terms;
+            if (firsts(item.rule, item.mark + 1, &terms)) {
+                terms.insert((*items)[item]);
+            }
 
             for (auto& rule : nonterm->rules) {
-                for (auto term : terms) {
-                    Item next = Item(rule.get(), 0, term);
-                    auto result = items.insert(next);
-                    if (result.second) {
-                        found.push_back(next);
-                    }
+                Item next = Item(rule, 0);
+                if ((*items)[next].insert(terms)) {
+                    found->push_back(next);
                 }
             }
         }
     }
 }
 
-void
-State::firsts(const vector<Symbol*>& symbols, std::set<Symbol*>* firsts)
+/** Solves for the firsts of the symbols in a rule after the given mark. */
+bool
+State::firsts(Nonterm::Rule* rule, size_t mark, Bitset* firsts)
 {
-    for (Symbol* sym : symbols) {
-        Nonterm* nonterm = dynamic_cast<Nonterm*>(sym);
+    for (size_t i = mark; i < rule->product.size(); i++) {
+        Symbol* sym = rule->product[i];
+        Nonterm* nonterm = Nonterm::cast(sym);
         if (nonterm) {
-            firsts->insert(nonterm->firsts.begin(), nonterm->firsts.end());
+            firsts->insert(nonterm->firsts);
             if (!nonterm->empty_first) {
-                return;
+                return false;
             }
         } else {
-            firsts->insert(sym);
-            return;
+            firsts->insert(sym->id);
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Merging states with the same core does not change the shift actions, but the
+ * union of the lookaheads can result in a state that reduces more than one rule
+ * for the same input symbol.
+ */
+State::Core
+State::core() const
+{
+    Core result;
+    for (auto& item : items) {
+        result.insert(std::make_pair(item.first.rule->id, item.first.mark));
+    }
+    return result;
+}
+
+void
+State::merge(const State& other)
+{
+    for (auto& item : other.items) {
+        items[item.first].insert(item.second);
+    }
+    nexts.insert(other.nexts.begin(), other.nexts.end());
+}
+
+void
+State::replace(std::map<State*, State*>& prime)
+{
+    for (auto& next : nexts) {
+        if (prime.count(next.second) > 0) {
+            next.second = prime[next.second];
         }
     }
 }
 
-std::unique_ptr<State>
-State::solve_next(Symbol* symbol, size_t id)
+void
+State::solve_reduces(Reduces* reduces) const
 {
-    std::unique_ptr<State> state = std::make_unique<State>(id);
-    for (auto item : items) {
-        if (item.next() == symbol)
-            state->items.insert(item.advance());
+    for (auto& item : items) {
+        if (!item.first.next()) {
+            for (size_t ahead : item.second) {
+                (*reduces)[ahead].insert(item.first.rule);
+            }
+        }
     }
-    state->closure();
-    if (state->items.size() == 0) {
-        state.reset();
+}
+
+/**
+ * Builds the kernels of all next states in a single pass over the items,
+ * grouping the advanced items by the symbol after each mark.  Only symbols
+ * that follow a mark have a next state.  The next states are ordered with the
+ * terminals first and then the nonterminals, each by their ids.
+ */
+void
+State::solve_nexts(Nexts* nexts) const
+{
+    std::map<std::pair<bool, size_t>, size_t> index;
+    
+    for (auto& item : items) {
+        Symbol* symbol = item.first.next();
+        if (!symbol) {
+            continue;
+        }
+        
+        auto key = std::make_pair(symbol->kind == Symbol::NONTERM,
+                                  symbol->id);
+        auto found = index.find(key);
+        if (found == index.end()) {
+            found = index.insert(std::make_pair(key, nexts->size())).first;
+            nexts->emplace_back(symbol, State(0));
+        }
+        State& next = (*nexts)[found->second].second;
+        next.items[item.first.advance()].insert(item.second);
+    }
+    
+    Nexts ordered;
+    for (auto& found : index) {
+        ordered.push_back(std::move((*nexts)[found.second]));
     }
-    return state;
+    *nexts = std::move(ordered);
 }
 
 void
@@ -81,49 +216,195 @@ State::add_next(Symbol* symbol, State* next) {
     nexts[symbol] = next;
 }
 
-void
-State::solve_actions(Item accept)
+State*
+State::get_next(Symbol* symbol) const
+{
+    auto found = nexts.find(symbol);
+    if (found != nexts.end()) {
+        return found->second;
+    } else {
+        return nullptr;
+    }
+}
+
+std::vector<State*>
+State::next_states() const
+{
+    std::vector<State*> result;
+    for (auto next : nexts) {
+        result.push_back(next.second);
+    }
+    return result;
+}
+
+size_t
+State::count_items() const {
+    return items.size();
+}
+
+/******************************************************************************/
+State::Actions::Actions():
+    reduce_default(nullptr){}
+
+/**
+ * Shifts the terminals that have a next state and reduces the rules of the
+ * completed items.  When a terminal can be both shifted and reduced, the rule
+ * is reduced if its precedence is higher than the terminal's and shifted if it
+ * is lower.  Equal precedences reduce for left associative terminals, shift for
+ * right associative terminals, and leave no action for nonassoc terminals so
+ * the input is an error.  Conflicts without precedence are reported and then
+ * resolved by shifting, or by reducing the rule listed first in the grammar.
+ */
+size_t
+State::solve_actions(Item accept, size_t ahead, const vector<Symbol*>& terms,
+                     std::ostream& report)
 {
-    // TODO Look for shift reduce conflicts.
-    
     actions = std::make_unique<Actions>();
 
-    for (auto item : items) {
-        Term* term = dynamic_cast<Term*>(item.next());
+    for (auto& item : items) {
+        Term* term = Term::cast(item.first.next());
         if (term) {
             auto found = nexts.find(term);
             if (found != nexts.end()) {
                 actions->shift[term] = found->second;
             }
         }
-        else if (!item.next()) {
-            if (item == accept) {
-                actions->accept[item.ahead] = item.rule;
-            } else {
-                actions->reduce[item.ahead] = item.rule;
-            }
+    }
+    
+    struct {
+        bool operator()(Nonterm::Rule* a, Nonterm::Rule* b) const {
+            return a->id < b->id;
+        }
+    } compare;
+    
+    size_t unresolved = 0;
+    Reduces reduces;
+    solve_reduces(&reduces);
+    
+    for (auto& reduce : reduces) {
+        Symbol* symbol = terms[reduce.first];
+        std::vector<Nonterm::Rule*> rules(reduce.second.begin(),
+                                          reduce.second.end());
+        std::sort(rules.begin(), rules.end(), compare);
+        Nonterm::Rule* rule = rules.front();
+        
+        if (rules.size() > 1) {
+            bool merging = merge_conflicts.count(reduce.first) > 0;
+            print_conflict("Reduce/reduce", symbol, rules,
+                           "reducing the first rule", merging, report);
+            unresolved++;
+        }
+        if (reduce.first == ahead && reduce.second.count(accept.rule) > 0) {
+            actions->accept[symbol] = accept.rule;
+            continue;
+        }
+        
+        auto shift = actions->shift.find(symbol);
+        if (shift == actions->shift.end()) {
+            actions->reduce[symbol] = rule;
+            continue;
+        }
+        
+        Term* term = Term::cast(symbol);
+        Term* prec = rule->precedence();
+        if (!term->precedence || !prec || !prec->precedence) {
+            print_conflict("Shift/reduce", symbol, {rule}, "shifting", false,
+                           report);
+            unresolved++;
+        } else if (prec->precedence > term->precedence) {
+            actions->shift.erase(shift);
+            actions->reduce[symbol] = rule;
+        } else if (prec->precedence < term->precedence) {
+            continue;
+        } else if (term->assoc == Term::LEFT) {
+            actions->shift.erase(shift);
+            actions->reduce[symbol] = rule;
+        } else if (term->assoc == Term::NONASSOC) {
+            actions->shift.erase(shift);
+            actions->error.insert(symbol);
         }
     }
+    return unresolved;
+}
 
-    //  actions->reduce();
-    //  auto found = previous.insert(std::move(actions));
-    //  this->actions = found.first->get();
+void
+State::print_conflict(const std::string& kind, const Symbol* ahead,
+                      const vector<Nonterm::Rule*>& rules,
+                      const std::string& resolution, bool merging,
+                      std::ostream& out) const
+{
+    out << kind << " conflict in state " << id;
+    if (merging) {
+        out << " from merging states";
+        for (size_t other : merged) {
+            out << " " << other;
+        }
+    }
+    out << " on ";
+    ahead->print(out);
+    out << ", " << resolution << ".\n";
+    for (auto rule : rules) {
+        out << "  ";
+        rule->print(out);
+        out << "\n";
+    }
 }
 
 void
 State::solve_gotos()
 {
     for (auto next : nexts) {
-        Nonterm* nonterm = dynamic_cast<Nonterm*>(next.first);
+        Nonterm* nonterm = Nonterm::cast(next.first);
         if (nonterm) {
             gotos[nonterm] = next.second;
         }
     }
 }
 
-bool
-State::operator<(const State& other) const {
-    return items < other.items;
+Nonterm::Rule*
+State::only_reduce() const
+{
+    if (actions->shift.size() > 0 || actions->accept.size() > 0) {
+        return nullptr;
+    }
+    if (actions->reduce.empty() || gotos.size() > 0) {
+        return nullptr;
+    }
+    
+    Nonterm::Rule* rule = actions->reduce.begin()->second;
+    for (auto& reduce : actions->reduce) {
+        if (reduce.second != rule) {
+            return nullptr;
+        }
+    }
+    return rule;
+}
+
+/**
+ * A state that reduces only one rule can reduce it for every lookahead that is
+ * not shifted, since a lookahead that is an error is still found before it is
+ * shifted by a later state.  States that accept or that have an error from a
+ * nonassoc terminal are left unchanged.  A default state without shifts then
+ * reduces without reading the next symbol.
+ */
+void
+State::solve_default()
+{
+    if (actions->reduce.empty() || actions->accept.size() > 0) {
+        return;
+    }
+    if (actions->error.size() > 0) {
+        return;
+    }
+    
+    Nonterm::Rule* rule = actions->reduce.begin()->second;
+    for (auto& reduce : actions->reduce) {
+        if (reduce.second != rule) {
+            return;
+        }
+    }
+    actions->reduce.clear();
+    actions->reduce_default = rule;
 }
 
 /******************************************************************************/
@@ -133,10 +414,16 @@ State::print(ostream& out) const {
 }
 
 void
-State::print_items(ostream& out) const
+State::print_items(ostream& out, const vector<Symbol*>& terms) const
 {
     for (auto& item : items) {
-        item.print(out);
+        item.first.print(out);
+        
+        out << " ,";
+        for (size_t id : item.second) {
+            out << " ";
+            terms[id]->print(out);
+        }
         out << "\n";
     }
     for (auto next : nexts) {
@@ -146,31 +433,61 @@ State::print_items(ostream& out) const
 }
 
 /******************************************************************************/
-State::Item::Item(Nonterm::Rule* rule, size_t mark, Symbol* ahead):
+State::Closures::Closures():
+    hits    (0),
+    misses  (0){}
+
+/**
+ * Returns the items added for a nonterminal with the given lookaheads.  On a
+ * miss, the items are solved by expanding the rules of the nonterminal.
+ */
+const vector<std::pair<State::Item, Bitset>>&
+State::Closures::find(Nonterm* nonterm, const Bitset& ahead)
+{
+    auto key = std::make_pair(nonterm->id, ahead);
+    auto found = cache.find(key);
+    if (found != cache.end()) {
+        hits++;
+        return found->second;
+    }
+    misses++;
+    
+    Items items;
+    vector<Item> pending;
+    for (auto& rule : nonterm->rules) {
+        Item item(rule, 0);
+        items[item].insert(ahead);
+        pending.push_back(item);
+    }
+    expand(&items, &pending);
+    
+    auto& result = cache[key];
+    result.assign(items.begin(), items.end());
+    return result;
+}
+
+size_t
+State::Closures::by_hash::operator()
+    (const std::pair<size_t, Bitset>& key) const {
+    return key.first * 0x9e3779b97f4a7c15 ^ key.second.hash();
+}
+
+/******************************************************************************/
+State::Item::Item(Nonterm::Rule* rule, size_t mark):
     rule    (rule),
-    mark    (mark),
-    ahead   (ahead){}
+    mark    (mark){}
 
 State::Item
-State::Item::advance() {
+State::Item::advance() const {
     if (mark < rule->product.size()) {
-        return Item(rule, mark + 1, ahead);
+        return Item(rule, mark + 1);
     } else {
-        return Item(rule, mark, ahead);
+        return Item(rule, mark);
     }
 }
 
-vector<Symbol*>
-State::Item::rest() {
-    vector<Symbol*> result;
-    result.insert(result.end(),
-                  rule->product.begin() + mark,
-                  rule->product.end());
-    return result;
-}
-
 Symbol*
-State::Item::next() {
+State::Item::next() const {
     if (mark < rule->product.size()) {
         return rule->product[mark];
     } else {
@@ -179,9 +496,9 @@ State::Item::next() {
 }
 
 Nonterm*
-State::Item::next_nonterm() {
+State::Item::next_nonterm() const {
     if (mark < rule->product.size()) {
-        return dynamic_cast<Nonterm*>(rule->product[mark]);
+        return Nonterm::cast(rule->product[mark]);
     } else {
         return nullptr;
     }
@@ -189,21 +506,13 @@ State::Item::next_nonterm() {
 
 bool
 State::Item::operator==(const Item& other) const {
-    if (rule != other.rule) {
-        return false;
-    } else if (ahead != other.ahead) {
-        return false;
-    } else {
-        return mark == other.mark;
-    }
+    return rule == other.rule && mark == other.mark;
 }
 
 bool
 State::Item::operator<(const Item& other) const {
     if (rule != other.rule) {
-        return rule < other.rule;
-    } else if (ahead != other.ahead) {
-        return ahead < other.ahead;
+        return rule->id < other.rule->id;
     } else {
         return mark < other.mark;
     }
@@ -241,7 +550,4 @@ State::Item::print(ostream& out) const
         }
         out << ".";
     }
-    
-    out << " , ";
-    ahead->print(out);
 }
@@ -9,6 +9,7 @@
 
 #include "symbols.hpp"
 #include <map>
+#include <unordered_map>
 
 /*******************************************************************************
  * Each state contains a set of possible rules that could be matched after
@@ -20,62 +21,148 @@ class State
     State(size_t id);
     size_t id;
     
+    /**
+     * The kernel items, those with a mark past the first symbol, identify a
+     * state since its closure only depends on the kernel.  The hash of the
+     * kernel is solved once before the state is interned.
+     */
+    size_t hash;
+    void solve_hash();
+    bool same_kernel(const State& other) const;
+    
     /**
      * Possible location within a grammar rule during parsing.  At any given
      * time the parser must be within at least one rule while waiting for one of
-     * several symbols that could be next based on the grammar.
+     * several symbols that could be next based on the grammar.  Each item is
+     * the core of a rule and a mark, and the state keeps the set of lookahead
+     * terminals for each item.
      */
     class Item {
       public:
-        Item(Nonterm::Rule* rule, size_t mark, Symbol* ahead);
+        Item(Nonterm::Rule* rule, size_t mark);
         Nonterm::Rule* rule;
         size_t mark;
-        Symbol* ahead;
         
-        Item advance();
-        std::vector<Symbol*> rest();
+        Item advance() const;
                 
-        Symbol* next();
-        Nonterm* next_nonterm();
+        Symbol* next() const;
+        Nonterm* next_nonterm() const;
         bool operator==(const Item& other) const;
         bool operator<(const Item& other) const;
         
         void print(std::ostream& out) const;
     };
     
-    void add(Item item);
+    void add(Item item, size_t ahead);
+    typedef std::map<Item, Bitset> Items;
+    
+    /** Returns the number of items, including those added by the closure. */
+    size_t count_items() const;
+    
+    /**
+     * Cache of the items added by the closure for a nonterminal and a set of
+     * lookaheads, which many states share.  Counts the hits and misses.
+     */
+    class Closures {
+      public:
+        Closures();
+        size_t hits;
+        size_t misses;
+        
+        const std::vector<std::pair<Item, Bitset>>&
+        find(Nonterm* nonterm, const Bitset& ahead);
+        
+      private:
+        struct by_hash {
+            size_t operator()(const std::pair<size_t, Bitset>& key) const;
+        };
+        std::unordered_map<std::pair<size_t, Bitset>,
+                           std::vector<std::pair<Item, Bitset>>,
+                           by_hash> cache;
+    };
+    
+    /** Adds items for the rules of each nonterminal that follows a mark. */
+    void closure(Closures* closures);
+    
+    /**
+     * The core of a state is its set of items without the lookahead symbols.
+     * States with the same core can be merged into a single LALR state.
+     */
+    typedef std::set<std::pair<size_t, size_t>> Core;
+    Core core() const;
+    void merge(const State& other);
+    
+    /**
+     * Lookaheads with a reduce/reduce conflict that no single merged state
+     * had, and the ids of the states merged when there are any.
+     */
+    std::set<size_t> merge_conflicts;
+    std::vector<size_t> merged;
+    void replace(std::map<State*, State*>& prime);
     
-    void closure();
+    /** Finds the rules reduced by the state for each lookahead symbol. */
+    typedef std::map<size_t, std::set<Nonterm::Rule*>> Reduces;
+    void solve_reduces(Reduces* reduces) const;
     
-    /** Returns the next state for a given input symbol. */
-    std::unique_ptr<State> solve_next(Symbol* symbol, size_t id);
+    /** Returns the kernels of the next states for each input symbol. */
+    typedef std::vector<std::pair<Symbol*, State>> Nexts;
+    void solve_nexts(Nexts* nexts) const;
     void add_next(Symbol* symbol, State* next);
+    State* get_next(Symbol* symbol) const;
+    std::vector<State*> next_states() const;
     
-    /** Shift or reduce actions given the next symbol. */
+    /**
+     * Shift or reduce actions given the next symbol.  The default rule is
+     * reduced for any symbol without an action, and the symbols made errors
+     * by nonassoc terminals are kept so they are never reduced by default.
+     */
     class Actions {
       public:
+        Actions();
         std::map<const Symbol*, State*> shift;
         std::map<const Symbol*, Nonterm::Rule*> accept;
         std::map<const Symbol*, Nonterm::Rule*> reduce;
+        std::set<const Symbol*> error;
+        Nonterm::Rule* reduce_default;
     };
     std::unique_ptr<Actions> actions;
-    void solve_actions(Item accept);
+    
+    /** Returns the number of conflicts not resolved by precedence. */
+    size_t solve_actions(Item accept, size_t ahead,
+                         const std::vector<Symbol*>& terms,
+                         std::ostream& report);
     
     /** Defines the next parse state after reduction of a rule. */
     std::map<Symbol*, State*> gotos;
     void solve_gotos();
     
+    /** Returns the rule if it is the only action of the state, or null. */
+    Nonterm::Rule* only_reduce() const;
+    
+    /** Replaces the reduces of a single rule with a default reduction. */
+    void solve_default();
+    
     void print(std::ostream& out) const;
-    void print_items(std::ostream& out) const;
-        
-    bool operator<(const State& other) const;
+    void print_items(std::ostream& out,
+                     const std::vector<Symbol*>& terms) const;
                 
   private:
-    std::set<Item> items;
+    Items items;
     std::map<Symbol*, State*> nexts;
+    
+    static void expand(Items* items, std::vector<Item>* found);
+    
+    /**
+     * Reports a conflict on a lookahead and the rules that are reduced, and
+     * the merged states if the conflict was added by merging them.
+     */
+    void print_conflict(const std::string& kind, const Symbol* ahead,
+                        const std::vector<Nonterm::Rule*>& rules,
+                        const std::string& resolution, bool merging,
+                        std::ostream& out) const;
 
-    static void firsts(const std::vector<Symbol*>& symbols,
-                       std::set<Symbol*>* firsts);
+    /** Returns true if all of the symbols after the mark can be empty. */
+    static bool firsts(Nonterm::Rule* rule, size_t mark, Bitset* firsts);
 };
 
 #endif
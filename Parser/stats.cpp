@@ -0,0 +1,126 @@
+#include "stats.hpp"
+
+#include <chrono>
+#include <fstream>
+#include <sys/resource.h>
+
+/******************************************************************************/
+Stats::Stats():
+    running (false),
+    began   (0){}
+
+void
+Stats::start(const std::string& name)
+{
+    stop();
+    phases.push_back({name, 0, 0});
+    running = true;
+    began = now();
+}
+
+void
+Stats::stop()
+{
+    if (!running) {
+        return;
+    }
+    phases.back().seconds = now() - began;
+    phases.back().peak = peak_memory();
+    running = false;
+}
+
+void
+Stats::count(const std::string& name, size_t value)
+{
+    for (auto& count : counts) {
+        if (count.first == name) {
+            count.second = value;
+            return;
+        }
+    }
+    counts.push_back({name, value});
+}
+
+double
+Stats::now()
+{
+    auto now = std::chrono::steady_clock::now().time_since_epoch();
+    return std::chrono::duration<double>(now).count();
+}
+
+/**
+ * On Linux the maximum resident size from getrusage is kept across exec, so a
+ * program started by a large process reports the peak of its parent.  The high
+ * water mark of the process itself is read from its status file instead.  The
+ * maximum resident size is in kilobytes on Linux and bytes on macOS.
+ */
+size_t
+Stats::peak_memory()
+{
+#ifdef __linux__
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line)) {
+        if (line.compare(0, 6, "VmHWM:") == 0) {
+            return std::stoul(line.substr(6)) * 1024;
+        }
+    }
+#endif
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+#ifdef __APPLE__
+    return (size_t)usage.ru_maxrss;
+#else
+    return (size_t)usage.ru_maxrss * 1024;
+#endif
+}
+
+/******************************************************************************/
+void
+Stats::print(std::ostream& out) const
+{
+    double total = 0;
+    for (auto& phase : phases) {
+        total += phase.seconds;
+    }
+
+    for (auto& phase : phases) {
+        std::string name = phase.name + ":";
+        name.resize(16, ' ');
+        out << name << phase.seconds * 1000 << " ms, ";
+        out << "peak " << phase.peak / 1024 << " KB\n";
+    }
+    out << "total:          " << total * 1000 << " ms\n";
+
+    for (auto& count : counts) {
+        std::string name = count.first + ":";
+        name.resize(24, ' ');
+        out << name << count.second << "\n";
+    }
+}
+
+/** Names of phases and counts are plain identifiers, so need no escaping. */
+void
+Stats::print_json(std::ostream& out) const
+{
+    out << "{\n";
+    out << "  \"phases\": [\n";
+    for (size_t i = 0; i < phases.size(); i++) {
+        const Phase& phase = phases[i];
+        out << "    {\"name\": \"" << phase.name << "\", ";
+        out << "\"seconds\": " << phase.seconds << ", ";
+        out << "\"peak_bytes\": " << phase.peak << "}";
+        out << (i + 1 < phases.size() ? ",\n" : "\n");
+    }
+    out << "  ],\n";
+
+    out << "  \"counts\": {\n";
+    for (size_t i = 0; i < counts.size(); i++) {
+        out << "    \"" << counts[i].first << "\": " << counts[i].second;
+        out << (i + 1 < counts.size() ? ",\n" : "\n");
+    }
+    out << "  }\n";
+    out << "}\n";
+}
@@ -0,0 +1,52 @@
+/*******************************************************************************
+ * Records where the time and memory go while generating a parser.  Each phase
+ * of reading the grammar, solving the lexer and the parse states, and writing
+ * the source code is timed, and the sizes of the automata are counted.
+ */
+#ifndef stats_hpp
+#define stats_hpp
+
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+/*******************************************************************************
+ * Times each phase by its wall clock time and records the peak memory of the
+ * process when the phase ends.  The peak never decreases, so the phase where it
+ * grows the most is the phase that used the most memory.  Counts are kept in
+ * the order they were recorded.  The report can be printed as text or as JSON
+ * so that the results of different runs can be compared.
+ */
+class Stats
+{
+  public:
+    Stats();
+
+    /** Starts timing a phase, ending the previous phase if still running. */
+    void start(const std::string& name);
+    void stop();
+
+    /** Records the number of objects of a kind, replacing any earlier count. */
+    void count(const std::string& name, size_t value);
+
+    void print(std::ostream& out) const;
+    void print_json(std::ostream& out) const;
+
+  private:
+    struct Phase {
+        std::string name;
+        double seconds;
+        size_t peak;
+    };
+    std::vector<Phase> phases;
+    std::vector<std::pair<std::string, size_t>> counts;
+
+    bool running;
+    double began;
+
+    static double now();
+    static size_t peak_memory();
+};
+
+#endif
@@ -10,6 +10,7 @@
 #define symbols_hpp
 
 #include "finite.hpp"
+#include "bitset.hpp"
 #include <string>
 #include <vector>
 #include <set>
@@ -28,6 +29,15 @@ class Nonterm : public Symbol
     Nonterm(const std::string& name);
     std::string name;
     size_t rank;
+    
+    /** Returns the symbol as a nonterminal, or null for other kinds. */
+    static Nonterm* cast(Symbol* symbol) {
+        if (symbol && symbol->kind == NONTERM) {
+            return static_cast<Nonterm*>(symbol);
+        } else {
+            return nullptr;
+        }
+    }
 
     virtual void print(std::ostream& out) const;
     virtual void write(std::ostream& out) const;
@@ -46,47 +56,45 @@ class Nonterm : public Symbol
         std::string action;
         size_t id;
         
+        /**
+         * The precedence of a rule is that of the terminal given after %prec,
+         * or otherwise that of the last terminal in the rule.
+         */
+        Term* prec;
+        Term* precedence() const;
+        
         virtual void print(std::ostream& out) const;
         virtual void write(std::ostream& out) const;
     };
     
-    std::vector<std::unique_ptr<Rule>> rules;
+    /** Rules of all nonterminals are built in an arena kept by the grammar. */
+    std::vector<Rule*> rules;
     
-    Nonterm::Rule* add_rule(const std::vector<Symbol*>& syms,
+    Nonterm::Rule* add_rule(Arena<Rule>* arena,
+                            const std::vector<Symbol*>& syms,
                             const std::string& action);
 
     /**
      * To find all possible parse states, the first step is to solve for all
      * terminals that could be the first in the productions for each
      * nonterminal. A nonterminal can also have an empty production rule of no
-     * symbols.
+     * symbols.  Sets of terminals are stored by the id of each terminal.
      */
-    std::set<Symbol*> firsts;
+    Bitset firsts;
     bool empty_first;
-    void solve_first(bool* found);
 
     /**
      * After finding the firsts, solve for all terminals that could follow each
      * nonterminal.
      */
-    std::set<Symbol*> follows;
-    void solve_follows(bool* found);
+    Bitset follows;
     
     /** Prints the input grammar in BNF form. */
     void print_rules(std::ostream& out) const;
-    void print_firsts(std::ostream& out) const;
-    void print_follows(std::ostream& out) const;
-        
-  private:
-    /** Called by solve for finding the set of firsts and follows. */
-    void insert_firsts(Rule* rule,
-                       bool* found);
-    void insert_follows(const std::set<Symbol*>& syms,
-                        bool* found);
-    void insert_follows(std::vector<Symbol*>::iterator symbol,
-                        std::vector<Symbol*>::iterator end,
-                        bool* epsilon,
-                        bool* found);
+    void print_firsts(std::ostream& out,
+                      const std::vector<Symbol*>& terms) const;
+    void print_follows(std::ostream& out,
+                       const std::vector<Symbol*>& terms) const;
 };
 
 #endif
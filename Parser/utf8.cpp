@@ -0,0 +1,126 @@
+#include "utf8.hpp"
+
+#include <algorithm>
+
+const int Utf8::max_code;
+
+/******************************************************************************/
+void
+Utf8::split(int first, int last, std::vector<Sequence>* result)
+{
+    /** Skips the surrogates, which are not encoded. */
+    if (first <= 0xdfff && last >= 0xd800) {
+        if (first < 0xd800) {
+            split(first, 0xd7ff, result);
+        }
+        if (last > 0xdfff) {
+            split(0xe000, last, result);
+        }
+        return;
+    }
+
+    /** Splits where the length of the encoding changes. */
+    static const int ends[] = {0x7f, 0x7ff, 0xffff, max_code};
+    for (int end : ends) {
+        if (first > last) {
+            break;
+        }
+        if (first <= end) {
+            split_length(first, std::min(last, end), result);
+            first = end + 1;
+        }
+    }
+}
+
+/**
+ * While the range crosses a boundary where the bytes after the first few are
+ * not all covered, the range is split at that boundary.  Once no split is
+ * needed, every byte of the first code point and of the last code point form
+ * the bounds of the ranges of each byte.
+ */
+void
+Utf8::split_length(int first, int last, std::vector<Sequence>* result)
+{
+    std::string low = encode(first);
+    for (size_t i = 1; i < low.size(); i++) {
+        int mask = (1 << (6 * i)) - 1;
+        if ((first & ~mask) != (last & ~mask)) {
+            if ((first & mask) != 0) {
+                split_length(first, first | mask, result);
+                split_length((first | mask) + 1, last, result);
+                return;
+            }
+            if ((last & mask) != mask) {
+                split_length(first, (last & ~mask) - 1, result);
+                split_length(last & ~mask, last, result);
+                return;
+            }
+        }
+    }
+
+    std::string high = encode(last);
+    Sequence sequence;
+    for (size_t i = 0; i < low.size(); i++) {
+        sequence.push_back({(unsigned char)low[i], (unsigned char)high[i]});
+    }
+    result->push_back(sequence);
+}
+
+/** Returns false for a first byte that cannot start a character. */
+bool
+Utf8::decode(int lead, std::istream& in, int* code)
+{
+    int length = 0;
+    if (lead < 0x80) {
+        *code = lead;
+        return true;
+    } else if (lead >= 0xc2 && lead <= 0xdf) {
+        length = 1;
+        *code = lead & 0x1f;
+    } else if (lead >= 0xe0 && lead <= 0xef) {
+        length = 2;
+        *code = lead & 0x0f;
+    } else if (lead >= 0xf0 && lead <= 0xf4) {
+        length = 3;
+        *code = lead & 0x07;
+    } else {
+        return false;
+    }
+
+    for (int i = 0; i < length; i++) {
+        int c = in.get();
+        if (c < 0x80 || c > 0xbf) {
+            return false;
+        }
+        *code = (*code << 6) | (c & 0x3f);
+    }
+
+    /** Rejects longer encodings than needed, surrogates and too large. */
+    static const int lowest[] = {0, 0x80, 0x800, 0x10000};
+    if (*code < lowest[length] || *code > max_code) {
+        return false;
+    }
+    return !(*code >= 0xd800 && *code <= 0xdfff);
+}
+
+std::string
+Utf8::encode(int code)
+{
+    std::string result;
+    if (code < 0x80) {
+        result.push_back((char)code);
+    } else if (code < 0x800) {
+        result.push_back((char)(0xc0 | (code >> 6)));
+        result.push_back((char)(0x80 | (code & 0x3f)));
+    } else if (code < 0x10000) {
+        result.push_back((char)(0xe0 | (code >> 12)));
+        result.push_back((char)(0x80 | ((code >> 6) & 0x3f)));
+        result.push_back((char)(0x80 | (code & 0x3f)));
+    } else {
+        result.push_back((char)(0xf0 | (code >> 18)));
+        result.push_back((char)(0x80 | ((code >> 12) & 0x3f)));
+        result.push_back((char)(0x80 | ((code >> 6) & 0x3f)));
+        result.push_back((char)(0x80 | (code & 0x3f)));
+    }
+    return result;
+}
@@ -0,0 +1,42 @@
+/*******************************************************************************
+ * Converts between Unicode code points and the bytes of their UTF-8 encoding.
+ * The lexer reads its input one byte at a time, so a range of code points in a
+ * regular expression is matched by a few sequences of byte ranges instead.
+ */
+#ifndef utf8_hpp
+#define utf8_hpp
+
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+/*******************************************************************************
+ * Code points use from one to four bytes.  The first byte gives the length of
+ * the sequence and the rest each carry six bits of the code point.  A range of
+ * code points with the same length is split until each part is the product of
+ * a range for each byte, such as [E0][A0-BF][80-BF] for U+0800 to U+0FFF.  The
+ * surrogates from U+D800 to U+DFFF are not valid in UTF-8 and never match.
+ */
+class Utf8
+{
+  public:
+    static const int max_code = 0x10ffff;
+
+    /** Ranges of bytes, one for each byte of the encoding in order. */
+    typedef std::vector<std::pair<int, int>> Sequence;
+
+    /** Finds the sequences that match every code point in the range. */
+    static void split(int first, int last, std::vector<Sequence>* result);
+
+    /** Reads the rest of a character after its first byte. */
+    static bool decode(int lead, std::istream& in, int* code);
+
+    static std::string encode(int code);
+
+  private:
+    static void split_length(int first, int last,
+                             std::vector<Sequence>* result);
+};
+
+#endif
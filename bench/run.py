@@ -0,0 +1,148 @@
+#!/usr/bin/env python3
+"""
+Benchmarks the parser generator on the grammars in this directory.  Each
+grammar is solved with each method of building the tables, and the time and
+peak memory of every phase are reported along with the number of states, the
+size of the packed tables and the size of the generated source code.
+
+    python3 bench/run.py                     build the generator and run
+    python3 bench/run.py --save base.json    keep the results as a baseline
+    python3 bench/run.py --compare base.json compare against the baseline
+
+The generator is built from Parser/*.cpp unless a binary is given with
+--parser.  Times are the fastest of --repeat runs to reduce the noise.
+"""
+
+import argparse
+import glob
+import json
+import os
+import subprocess
+import sys
+import tempfile
+
+ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+BENCH = os.path.join(ROOT, "bench")
+
+METHODS = [("canonical", []), ("lalr", ["--lalr"]), ("minimal", ["--minimal"])]
+
+COUNTS = [
+    ("states", "table_states"),
+    ("actions", "action_slots"),
+    ("gotos", "goto_slots"),
+    ("dfa", "dfa_nodes_minimized"),
+    ("code", "code_bytes"),
+]
+
+def build(output):
+    sources = sorted(glob.glob(os.path.join(ROOT, "Parser", "*.cpp")))
+    command = [os.environ.get("CXX", "c++"), "-std=c++14", "-O2", "-pthread",
+               "-o", output] + sources
+    print("building " + output, file=sys.stderr)
+    subprocess.check_call(command)
+
+def measure(parser, grammar, flags, repeat, timeout=None):
+    """Runs the generator and keeps the fastest time of each phase."""
+    best = None
+    for _ in range(repeat):
+        with tempfile.NamedTemporaryFile(suffix=".json") as report:
+            with open(grammar) as source:
+                subprocess.check_call(
+                    [parser, "--stats-json", report.name] + flags,
+                    stdin=source, stdout=subprocess.DEVNULL,
+                    stderr=subprocess.DEVNULL, timeout=timeout)
+            stats = json.load(open(report.name))
+        if best is None:
+            best = stats
+            continue
+        for phase, fastest in zip(stats["phases"], best["phases"]):
+            fastest["seconds"] = min(fastest["seconds"], phase["seconds"])
+            fastest["peak_bytes"] = max(fastest["peak_bytes"],
+                                        phase["peak_bytes"])
+    return best
+
+def summarize(stats):
+    result = {name: stats["counts"].get(key, 0) for name, key in COUNTS}
+    result["phases"] = {p["name"]: p["seconds"] for p in stats["phases"]}
+    result["seconds"] = sum(result["phases"].values())
+    result["peak"] = max([p["peak_bytes"] for p in stats["phases"]] + [0])
+    return result
+
+def change(now, before):
+    if not before:
+        return ""
+    return " (%+.0f%%)" % (100.0 * (now - before) / before)
+
+def report(results, baseline):
+    header = "%-8s %-10s" % ("grammar", "method")
+    for name, _ in COUNTS:
+        header += " %8s" % name
+    header += " %10s %8s" % ("ms", "peak MB")
+    print(header)
+
+    for key in sorted(results):
+        now = results[key]
+        before = baseline.get(key, {})
+        line = "%-8s %-10s" % tuple(key.split("/"))
+        for name, _ in COUNTS:
+            line += " %8d" % now[name]
+        line += " %10.1f" % (now["seconds"] * 1000)
+        line += " %8.1f" % (now["peak"] / 1048576.0)
+        print(line)
+        if before:
+            print("%19s" % "" + "".join(
+                " %8s" % change(now[name], before.get(name)).strip()
+                for name, _ in COUNTS) +
+                " %10s" % change(now["seconds"], before["seconds"]).strip() +
+                " %8s" % change(now["peak"], before["peak"]).strip())
+
+def phases(results):
+    names = []
+    for key in sorted(results):
+        index = 0
+        for name in results[key]["phases"]:
+            if name not in names:
+                names.insert(index, name)
+            index = names.index(name) + 1
+    print("\nmilliseconds by phase")
+    print("%-19s" % "" + "".join(" %8s" % n[:8] for n in names))
+    for key in sorted(results):
+        times = results[key]["phases"]
+        print("%-19s" % key + "".join(
+            " %8.1f" % (times.get(n, 0) * 1000) for n in names))
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n\n")[0])
+    parser.add_argument("--parser", help="generator to run, built if omitted")
+    parser.add_argument("--repeat", type=int, default=3)
+    parser.add_argument("--save", help="write the results to a JSON file")
+    parser.add_argument("--compare", help="baseline JSON to compare against")
+    parser.add_argument("grammars", nargs="*",
+                        help="grammars to run, all in bench/ by default")
+    args = parser.parse_args()
+
+    binary = args.parser
+    if not binary:
+        binary = os.path.join(tempfile.gettempdir(), "parser-bench")
+        build(binary)
+
+    grammars = args.grammars or sorted(glob.glob(os.path.join(BENCH, "*.bnf")))
+    results = {}
+    for grammar in grammars:
+        name = os.path.splitext(os.path.basename(grammar))[0]
+        for method, flags in METHODS:
+            stats = measure(binary, grammar, flags, max(1, args.repeat))
+            results[name + "/" + method] = summarize(stats)
+
+    baseline = {}
+    if args.compare:
+        baseline = json.load(open(args.compare))
+    report(results, baseline)
+    phases(results)
+
+    if args.save:
+        with open(args.save, "w") as out:
+            json.dump(results, out, indent=2, sort_keys=True)
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,179 @@
+#!/usr/bin/env python3
+"""
+Measures how the parser generator scales by solving synthetic grammars of
+growing size, and plots the time and memory against the number of rules.
+
+    python3 bench/sweep.py --vary nonterms=25,50,100,200,400 --plot scale.png
+    python3 bench/sweep.py --vary terms=50,100,200 --vary regex=0,0.5,1
+
+Each --vary names a parameter of bench/synth.py and the values to try, and
+every combination of the values is solved.  Other parameters can be fixed with
+--set.  The results are printed as a table and can be written to a CSV file
+with --csv.  The plot needs matplotlib.  With one series it shows the time of
+each phase, so it is clear whether the lexer or the parse states grow the
+fastest, and with more it shows the total time of each series.
+"""
+
+import argparse
+import csv
+import itertools
+import os
+import sys
+import tempfile
+
+from run import build, measure
+import synth
+
+PHASES = ["lexer_solve", "lexer_reduce", "solve_states", "merge_states",
+          "solve_actions", "write_code"]
+
+COUNTS = ["rules", "dfa_nodes", "lr_states", "table_states", "conflicts",
+          "code_bytes"]
+
+def parse_value(text):
+    for kind in (int, float):
+        try:
+            return kind(text)
+        except ValueError:
+            pass
+    raise argparse.ArgumentTypeError("not a number: " + text)
+
+def parse_list(text):
+    name, _, values = text.partition("=")
+    if name not in synth.DEFAULTS or not values:
+        names = ", ".join(sorted(synth.DEFAULTS))
+        raise argparse.ArgumentTypeError(
+            "expected one of %s=VALUE,... " % names)
+    return name, [parse_value(value) for value in values.split(",")]
+
+def run(binary, params, flags, repeat, timeout):
+    """Solves one synthetic grammar, returning None if the generator fails."""
+    with tempfile.NamedTemporaryFile("w", suffix=".bnf", delete=False) as out:
+        out.write(synth.generate(**params))
+    try:
+        return measure(binary, out.name, flags, repeat, timeout)
+    except Exception as error:
+        print("failed with %s: %s" % (params, error), file=sys.stderr)
+        return None
+    finally:
+        os.unlink(out.name)
+
+def row(params, stats):
+    result = dict(params)
+    if stats is None:
+        result["status"] = "failed"
+        return result
+    times = {p["name"]: p["seconds"] for p in stats["phases"]}
+    result["status"] = "ok"
+    for name in COUNTS:
+        result[name] = stats["counts"].get(name, 0)
+    for name in PHASES:
+        result[name + "_ms"] = times.get(name, 0) * 1000
+    result["total_ms"] = sum(times.values()) * 1000
+    result["peak_mb"] = max([p["peak_bytes"] for p in stats["phases"]] + [0])
+    result["peak_mb"] /= 1048576.0
+    return result
+
+def print_table(rows, varied):
+    columns = varied + ["rules", "lr_states", "conflicts", "total_ms",
+                        "lexer_reduce_ms", "solve_states_ms", "peak_mb"]
+    print(" ".join("%12s" % column[:12] for column in columns))
+    for result in rows:
+        cells = []
+        for column in columns:
+            value = result.get(column, result["status"])
+            if isinstance(value, float):
+                cells.append("%12.2f" % value)
+            else:
+                cells.append("%12s" % value)
+        print(" ".join(cells))
+
+def plot(rows, varied, path):
+    try:
+        import matplotlib
+        matplotlib.use("Agg")
+        import matplotlib.pyplot as pyplot
+    except ImportError:
+        print("matplotlib is needed to plot, use --csv instead",
+              file=sys.stderr)
+        return
+
+    rows = [result for result in rows if result["status"] == "ok"]
+    series = {}
+    for result in rows:
+        key = ", ".join("%s %s" % (name, result[name]) for name in varied[1:])
+        series.setdefault(key, []).append(result)
+
+    figure, (times, memory) = pyplot.subplots(1, 2, figsize=(12, 5))
+    for key, results in sorted(series.items()):
+        results.sort(key=lambda result: result["rules"])
+        rules = [result["rules"] for result in results]
+        if len(series) == 1:
+            for name in PHASES + ["total"]:
+                times.plot(rules, [r[name + "_ms"] for r in results],
+                           marker="o", label=name)
+        else:
+            times.plot(rules, [r["total_ms"] for r in results],
+                       marker="o", label=key)
+        memory.plot(rules, [r["peak_mb"] for r in results],
+                    marker="o", label=key or "peak")
+
+    for axes, label in ((times, "milliseconds"), (memory, "peak MB")):
+        axes.set_xscale("log")
+        axes.set_yscale("log")
+        axes.set_xlabel("rules")
+        axes.set_ylabel(label)
+        axes.grid(True, which="both", alpha=0.3)
+        axes.legend(fontsize="small")
+    figure.suptitle("varying " + ", ".join(varied))
+    figure.tight_layout()
+    figure.savefig(path)
+    print("wrote " + path, file=sys.stderr)
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n\n")[0])
+    parser.add_argument("--vary", type=parse_list, action="append",
+                        required=True, metavar="NAME=V1,V2,...")
+    parser.add_argument("--set", type=parse_list, action="append",
+                        default=[], metavar="NAME=VALUE")
+    parser.add_argument("--method", choices=["canonical", "lalr", "minimal"],
+                        default="lalr")
+    parser.add_argument("--parser", help="generator to run, built if omitted")
+    parser.add_argument("--repeat", type=int, default=1)
+    parser.add_argument("--timeout", type=float, default=600,
+                        help="seconds before giving up on a grammar")
+    parser.add_argument("--csv", help="write the results to a CSV file")
+    parser.add_argument("--plot", help="write a plot to an image file")
+    args = parser.parse_args()
+
+    binary = args.parser
+    if not binary:
+        binary = os.path.join(tempfile.gettempdir(), "parser-bench")
+        build(binary)
+    flags = [] if args.method == "canonical" else ["--" + args.method]
+
+    fixed = {name: values[0] for name, values in args.set}
+    varied = [name for name, _ in args.vary]
+    rows = []
+    for values in itertools.product(*[values for _, values in args.vary]):
+        params = dict(fixed)
+        params.update(zip(varied, values))
+        stats = run(binary, params, flags, max(1, args.repeat), args.timeout)
+        rows.append(row(params, stats))
+        print(" ".join("%s=%s" % item for item in sorted(params.items())) +
+              " done", file=sys.stderr)
+
+    print_table(rows, varied)
+    if args.csv:
+        names = []
+        for result in rows:
+            names += [name for name in result if name not in names]
+        with open(args.csv, "w", newline="") as out:
+            writer = csv.DictWriter(out, fieldnames=names)
+            writer.writeheader()
+            writer.writerows(rows)
+    if args.plot:
+        plot(rows, varied, args.plot)
+
+if __name__ == "__main__":
+    main()
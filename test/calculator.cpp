@@ -61,12 +61,6 @@ reduce_total(Table* table, unique_ptr<Expr>& E1)
     return result;
 }
 
-unique_ptr<Expr>
-reduce_add(Table* table, unique_ptr<Expr>& E1)
-{
-    return std::move(E1);
-}
-
 unique_ptr<Expr>
 reduce_add_mul(Table* table, unique_ptr<Expr>& E1, unique_ptr<Expr>& E2)
 {
@@ -75,12 +69,6 @@ reduce_add_mul(Table* table, unique_ptr<Expr>& E1, unique_ptr<Expr>& E2)
     return result;
 }
 
-unique_ptr<Expr>
-reduce_mul(Table* table, unique_ptr<Expr>& E1)
-{
-    return std::move(E1);
-}
-
 unique_ptr<Expr>
 reduce_mul_int(Table* table, unique_ptr<Expr>& E1, unique_ptr<Expr>& E2)
 {
@@ -95,18 +83,6 @@ reduce_paren(Table* table, unique_ptr<Expr>& E1)
     return std::move(E1);
 }
 
-unique_ptr<Expr>
-reduce_num(Table* table, unique_ptr<Expr>& E1)
-{
-    return std::move(E1);
-}
-
-unique_ptr<Expr>
-reduce_hex(Table* table, unique_ptr<Expr>& E1)
-{
-    return std::move(E1);
-}
-
 
 /******************************************************************************/
 Calculator::Calculator(){}
@@ -201,32 +177,15 @@ Calculator::advance(Table* table, Symbol* sym, Value* val)
         switch (type) {
             case 'S': {
                 push(next, sym, val);
+                reduce_ready(table);
                 return true;
             }
             case 'A': {
-                Value* result = nullptr;
-                if (rules[next].reduce) {
-                    result = rules[next].reduce(table, values);
-                }
-                pop(rules[next].length);
-                
-                top = states.back();
-                int found = find_goto(top, rules[next].nonterm);
-                
-                push(found, rules[next].nonterm, result);
+                reduce(table, next);
                 return true;
             }
             case 'R': {
-                Value* result = nullptr;
-                if (rules[next].reduce) {
-                    result = rules[next].reduce(table, values);
-                }
-                pop(rules[next].length);
-                
-                top = states.back();
-                int found = find_goto(top, rules[next].nonterm);
-                
-                push(found, rules[next].nonterm, result);
+                reduce(table, next);
                 break;
             }
             default: {
@@ -238,6 +197,35 @@ Calculator::advance(Table* table, Symbol* sym, Value* val)
     }
 }
 
+void
+Calculator::reduce(Table* table, int rule)
+{
+    Value* result = nullptr;
+    if (rules[rule].reduce) {
+        result = rules[rule].reduce(table, values);
+    } else if (rules[rule].length == 1) {
+        result = values.back();
+    }
+    pop(rules[rule].length);
+    
+    int found = find_goto(states.back(), rules[rule].nonterm);
+    push(found, rules[rule].nonterm, result);
+}
+
+/**
+ * States that only reduce by default do not depend on the next symbol, so
+ * their rules are reduced as soon as the state is reached.
+ */
+void
+Calculator::reduce_ready(Table* table)
+{
+    int rule = find_ready(states.back());
+    while (rule >= 0) {
+        reduce(table, rule);
+        rule = find_ready(states.back());
+    }
+}
+
 /******************************************************************************/
 void
 Calculator::push(int s, Symbol* sym, Value* val)
@@ -257,25 +245,37 @@ Calculator::pop(size_t count)
     }
 }
 
+/**
+ * The entry for a symbol is at the base of the state plus the id of the
+ * symbol, and is only for that symbol if its check matches the id.
+ */
 char
 find_action(int state, Symbol* sym, int* next) {
-    for (Act* s = states[state].act; s->sym; s++) {
-        if (s->sym == sym) {
-            *next = s->next;
-            return s->type;
-        }
+    int base = states[state].act;
+    if (base >= 0 && act_check[base + sym->id] == sym->id) {
+        *next = act_next[base + sym->id].next;
+        return act_next[base + sym->id].type;
+    }
+    if (states[state].reduce >= 0) {
+        *next = states[state].reduce;
+        return 'R';
     }
     return -1;
 }
 
 int
 find_goto(int state, Symbol* sym) {
-   if (!states[state].go)
+    int base = states[state].go;
+    if (base >= 0 && go_check[base + sym->id] == sym->id) {
+        return go_next[base + sym->id];
+    }
+    return go_default[sym->id];
+}
+
+int
+find_ready(int state) {
+    if (states[state].act >= 0) {
         return -1;
-   for (Go* g = states[state].go; g->sym; g++) {
-       if (g->sym == sym) {
-           return g->state;
-       }
-   }
-   return -1;
+    }
+    return states[state].reduce;
 }
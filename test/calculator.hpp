@@ -28,6 +28,7 @@ class Table {
  */
 struct Symbol {
     const char* name;
+    int         id;
 };
 
 extern Symbol* Endmark;
@@ -49,25 +50,34 @@ struct Rule {
 extern Rule rules[];
 
 struct Act {
-    Symbol* sym;
     char    type;
     int     next;
 };
 
-struct Go {
-    Symbol* sym;
-    int     state;
-};
+extern int act_check[];
+extern struct Act act_next[];
 
+/**
+ * The actions and gotos of each state start at a base within the packed
+ * arrays, or are -1 if the state has none.  The reduce is the default rule of
+ * the state, or -1 if it has none.  A goto not found for a state is the
+ * default of the nonterminal.
+ */
 struct State {
-    struct Act* act;
-    struct Go*  go;
+    int     act;
+    int     go;
+    int     reduce;
 };
 
+extern int go_check[];
+extern int go_next[];
+extern int go_default[];
+
 extern struct State states[];
 
 char find_action(int state, Symbol* sym, int* next);
 int find_goto(int state, Symbol* sym);
+int find_ready(int state);
 
 /*******************************************************************************
  * User defined classes for the calculator.
@@ -97,6 +107,8 @@ class Calculator {
     std::vector<Value*>  values;
     
     bool advance(Table* table, Symbol* sym, Value* val);
+    void reduce(Table* table, int rule);
+    void reduce_ready(Table* table);
 
     /** Utility methods for adding to the stack. */
     void push(int s, Symbol* sym, Value* val);
@@ -0,0 +1,36 @@
+#!/bin/sh
+#
+# Checks the conflicts reported for test/merge.bnf, a grammar that is LR(1) but
+# not LALR(1).  Canonical and minimal tables have no conflicts.  LALR(1) tables
+# merge two states into one that reduces either rule on 'c' and on 'd', and
+# each of those conflicts is reported once, as in test/merge.txt.  The report
+# is the same when the states are loaded from a cache.
+#
+#     sh test/merge.sh path/to/parser
+#
+parser=${1:-./parser}
+dir=$(dirname "$0")
+cache=$(mktemp)
+status=0
+
+check() {
+    name=$1
+    expected=$2
+    shift 2
+    if ! "$parser" "$@" < "$dir/merge.bnf" 2>&1 >/dev/null |
+            diff -u "$expected" -; then
+        echo "$name: unexpected conflict report"
+        status=1
+    fi
+}
+
+check canonical /dev/null
+check minimal /dev/null --minimal
+check lalr "$dir/merge.txt" --lalr --cache "$cache"
+check "lalr from cache" "$dir/merge.txt" --lalr --cache "$cache"
+rm -f "$cache"
+
+if [ $status -eq 0 ]; then
+    echo "Conflicts reported as expected."
+fi
+exit $status